@@ -0,0 +1,326 @@
+/*
+ * attach.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "tduint.h"
+#include "nowrap.h"
+#include "server.h"
+#include "attach.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <limits.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <curses.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/* The client side of tdu --serve: the same screen as the interface,
+   but with nothing of the tree but the lines on screen, which are
+   asked for each time the screen is drawn.  See server.h for the
+   protocol. */
+
+static FILE *server_in;
+static FILE *server_out;
+static long total_lines = 1;
+
+static void
+attach_lost ()
+{
+	tdu_interface_finish(-1);
+	fprintf(stderr, "tdu: lost connection to server\n");
+	exit(1);
+}
+
+/* Send a request and read an "OK n" reply.  Returns n, or -1 after
+   showing the error. */
+static long
+attach_request (const char *fmt, ...)
+{
+	char reply[SERVER_LINE_MAX];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(server_out, fmt, ap);
+	va_end(ap);
+	if (fflush(server_out) || !fgets(reply, sizeof(reply), server_in))
+		attach_lost();
+	if (!strncmp(reply, "OK ", 3))
+		return atol(reply + 3);
+	reply[strcspn(reply, "\n")] = '\0';
+	status_line_message(reply);
+	return -1;
+}
+
+/* Draw one row as sent by the server; see server_rows(). */
+static void
+attach_draw_row (int y, char *row)
+{
+	char *field[6];
+	char *p, *q;
+	int i, n;
+
+	for (i = 0, p = row; i < 6; ++i) {
+		field[i] = p;
+		p += strcspn(p, "\t\n");
+		if (*p) *p++ = '\0';
+	}
+	/* unescape the name */
+	for (p = q = field[5]; *p; ++p, ++q) {
+		if (*p == '\\' && p[1]) {
+			++p;
+			*p = (*p == 't') ? '\t' : (*p == 'n') ? '\n' : *p;
+		}
+		*q = *p;
+	}
+	*q = '\0';
+
+	wmove(main_window, y, 0);
+	wclrtoeol(main_window);
+	wprintw_nowrap(main_window, "%11s ", field[1]);
+	if (show_descendents)
+		wprintw_nowrap(main_window, "%11s ", field[2]);
+	n = strlen(field[3]);
+	for (i = 0; i < n; ++i) {
+		bool last = (field[3][i] == 'L');
+		display_branch((i == n - 1)
+			       ? (last ? IAM_LAST : IAM_NOTLAST)
+			       : (last ? PARENT_LAST : PARENT_NOTLAST));
+	}
+	wprintw_nowrap(main_window, "%s", field[5]);
+	if (atoi(field[4]))
+		wprintw_nowrap(main_window, " ...");
+}
+
+/* Bring the cursor into range and redraw the screen from the server. */
+static void
+attach_display ()
+{
+	char row[PATH_MAX + 256];
+	int y = 0;
+
+	if (cursor_line >= total_lines) cursor_line = total_lines - 1;
+	if (cursor_line < 0) cursor_line = 0;
+	if (cursor_line < start_line)
+		start_line = cursor_line;
+	else if (cursor_line > start_line + visible_lines - 1)
+		start_line = cursor_line - (visible_lines - 1);
+	if (start_line < 0) start_line = 0;
+
+	fprintf(server_out, "ROWS %d %d\n", start_line, visible_lines);
+	if (fflush(server_out) || !fgets(row, sizeof(row), server_in)
+	    || sscanf(row, "TOTAL %ld", &total_lines) != 1)
+		attach_lost();
+	while (1) {
+		if (!fgets(row, sizeof(row), server_in)) attach_lost();
+		if (!strncmp(row, "END", 3)) break;
+		if (row[0] == 'R' && y < visible_lines)
+			attach_draw_row(y++, row);
+	}
+	for (; y < visible_lines; ++y) {
+		wmove(main_window, y, 0);
+		wclrtoeol(main_window);
+	}
+
+	/* the tree may have shrunk under the cursor */
+	if (cursor_line >= total_lines) {
+		attach_display();
+		return;
+	}
+	wrefresh(status_window);
+	wmove(main_window, cursor_line - start_line, 0);
+	wrefresh(main_window);
+}
+
+static int
+attach_connect (const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "tdu: %s: socket path too long\n", path);
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+	    || connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		fprintf(stderr, "tdu: %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	return fd;
+}
+
+/* Handle one key.  Returns 0 to detach. */
+static int
+attach_keypress (int key)
+{
+	static int expandlevel = 0;
+	static int lastkey = -1;
+	int sortrecursive = (lastkey == '=');
+	long n;
+
+	switch (key) {
+	case ERR:
+	case '=':
+		break;
+	case KEY_RESIZE:
+		tdu_interface_resize();
+		return 1;
+	case 3: case 27: case 'Q': case 'q': case 'X': case 'x':
+		return 0;
+	case '?':
+		tdu_interface_help(ATTACH_ONLINE_HELP);
+		break;
+	case 'c': case 'C':
+		tdu_interface_help(TDU_COPYRIGHT_INFO);
+		break;
+	case 16: case 'K': case 'k': case KEY_PREVIOUS: case KEY_UP:
+		--cursor_line;
+		break;
+	case 14: case 'J': case 'j': case KEY_NEXT: case KEY_DOWN:
+		++cursor_line;
+		break;
+	case '<': case KEY_HOME:
+		cursor_line = 0;
+		break;
+	case '>': case KEY_END:
+		cursor_line = total_lines - 1;
+		break;
+	case KEY_SPREVIOUS:
+		cursor_line -= 10;
+		break;
+	case KEY_SNEXT:
+		cursor_line += 10;
+		break;
+	case KEY_PPAGE:
+		cursor_line -= visible_lines - 1;
+		start_line -= visible_lines - 1;
+		break;
+	case KEY_NPAGE:
+		cursor_line += visible_lines - 1;
+		start_line += visible_lines - 1;
+		break;
+	case 12:                    /* C-l */
+		start_line = cursor_line - visible_lines / 2;
+		break;
+	case 'P': case 'p':
+		if ((n = attach_request("PARENT %d\n", cursor_line)) >= 0)
+			cursor_line = n;
+		break;
+	case 'u': case 'U': case 's': case 'S':
+	case 'n': case 'N': case 'd': case 'D':
+		attach_request("SORT %d %c %d %d\n", cursor_line, tolower(key),
+			       isupper(key) ? 1 : 0, sortrecursive);
+		break;
+	case 'l': case 'L': case '1': case 6: case KEY_RIGHT:
+		key = KEY_RIGHT;
+		if (lastkey == KEY_RIGHT || (lastkey >= '2' && lastkey <= '9'))
+			++expandlevel;
+		else
+			expandlevel = 1;
+		attach_request("EXPAND %d %d\n", cursor_line, expandlevel);
+		break;
+	case '2': case '3': case '4': case '5':
+	case '6': case '7': case '8': case '9':
+		expandlevel = key - '0';
+		attach_request("EXPAND %d %d\n", cursor_line, expandlevel);
+		break;
+	case '*':
+		attach_request("EXPAND %d -1\n", cursor_line);
+		break;
+	case 'h': case 'H': case '0': case 2: case KEY_LEFT:
+		expandlevel = 0;
+		attach_request("COLLAPSE %d\n", cursor_line);
+		break;
+	case 'r': case 'R':
+	{
+		static char file[PATH_MAX] = "";
+		if (tdu_interface_prompt("Update from du output in file: ",
+					 file, sizeof(file), NULL) && *file
+		    && (n = attach_request("UPDATE %s\n", file)) >= 0) {
+			char message[64];
+			snprintf(message, sizeof(message),
+				 "%ld %s changed.", n,
+				 (n == 1) ? "entry" : "entries");
+			status_line_message(message);
+		}
+		break;
+	}
+	case '#':
+		show_descendents = !show_descendents;
+		break;
+	case 'a': case 'A':
+		ascii_tree_chars = !ascii_tree_chars;
+		break;
+	default:
+		beep();
+		break;
+	}
+	lastkey = key;
+	return 1;
+}
+
+/* Run the interface on a tree served at path.  Returns an exit
+   status. */
+int
+attach_run (const char *path)
+{
+	int fd, key = -1;
+
+	if ((fd = attach_connect(path)) < 0)
+		return 1;
+	if (!(server_in = fdopen(fd, "r"))
+	    || !(server_out = fdopen(dup(fd), "w"))) {
+		perror("attach_run: fdopen");
+		return 1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, tdu_interface_finish);
+
+	tdu_interface_init_ncurses();
+	status_line_message("Attached to tdu server.  Type ? for help.");
+	attach_display();
+
+	while (1) {
+		bool first = (key == -1);
+
+		/* wait for a key, then take every key already typed
+		   before asking the server for the screen */
+		key = tdu_interface_wait_key();
+		do {
+			if (!attach_keypress(key)) {
+				fputs("QUIT\n", server_out);
+				fflush(server_out);
+				tdu_interface_finish(-1);
+				return 0;
+			}
+		} while ((key = wgetch(main_window)) != ERR);
+		if (first) status_line_message(NULL);
+		attach_display();
+	}
+}
@@ -0,0 +1,53 @@
+/*
+ * attach.h
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#ifndef ATTACH_H
+#define ATTACH_H
+/*****************************************************************************/
+
+#include "tdu.h"
+
+#define ATTACH_ONLINE_HELP \
+"Attached to a tdu server.  The tree is shared; what's expanded is yours.\n" \
+"NAVIGATION:\n" \
+"  UP,DOWN,PGUP,PGDOWN   up,down by line,page\n" \
+"  HOME or <,END or >    first, last line\n" \
+"  p                     up to parent directory\n" \
+"  Ctrl-L                recenter line\n" \
+"EXPANDING/COLLAPSING:\n" \
+"  LEFT or 0, RIGHT   collapse, expand\n" \
+"  1-9,*              expand 1-9,all levels\n" \
+"SORTING CHILDREN (for everyone attached):\n" \
+"  s,S   by size (ascending, descending)\n" \
+"  n,N   by name (ascending, descending)\n" \
+"  d,D   by number of descendents (ascending, descending)\n" \
+"  u,U   unsorted, reverse\n" \
+"  =     prefix to sort recursively\n" \
+"MISCELLANEOUS:\n" \
+"  r     update from newer du output in a file (on the server)\n" \
+"  #     toggle display of number of descendents\n" \
+"  a     toggle ASCII tree characters\n" \
+"  q     detach\n"
+
+int attach_run (const char *path);
+
+/*****************************************************************************/
+#endif /* ATTACH_H */
@@ -0,0 +1,350 @@
+/*
+ * batch.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "batch.h"
+#include "metric.h"
+#include "history.h"
+#include "expr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+/* Entries are written as they are found, one per line (or one JSON
+   object per line, inside an array), so that nothing but the tree
+   itself has to be held in memory. */
+
+static const batch_query_s *query;
+static FILE *out;
+static long nwritten;
+static unsigned char *matched = NULL;	/* by id, if there's a where */
+static long nmatched;			/* ids covered */
+
+/* Is a node to be written, as far as the where expression goes? */
+static bool
+batch_matches (const node_s *node)
+{
+	return !matched || (node->id >= 0 && node->id < nmatched
+			    && matched[node->id]);
+}
+
+void
+batch_query_init (batch_query_s *q)
+{
+	q->path = NULL;
+	q->top = 0;
+	q->depth = -2;		/* depends on whether top is given */
+	q->min_size = 0;
+	q->where = NULL;
+	q->format = BATCH_TEXT;
+}
+
+/* Returns the format named, or -1. */
+int
+batch_parse_format (const char *s)
+{
+	if (!strcmp(s, "text")) return BATCH_TEXT;
+	if (!strcmp(s, "tsv")) return BATCH_TSV;
+	if (!strcmp(s, "json")) return BATCH_JSON;
+	return -1;
+}
+
+static void
+write_json_string (const char *s)
+{
+	putc('"', out);
+	for (; *s; ++s) {
+		unsigned char c = *s;
+		if (c == '"' || c == '\\')
+			fprintf(out, "\\%c", c);
+		else if (c == '\n')
+			fputs("\\n", out);
+		else if (c == '\t')
+			fputs("\\t", out);
+		else if (c < 0x20)
+			fprintf(out, "\\u%04x", c);
+		else
+			putc(c, out);
+	}
+	putc('"', out);
+}
+
+static void
+write_header ()
+{
+	int m;
+
+	if (query->format == BATCH_TSV) {
+		fputs("size\t", out);
+		for (m = 0; m < nmetrics; ++m)
+			fprintf(out, "%s\t", metrics[m].name);
+		if (nsnapshots > 1)
+			fputs("growth_7d\tgrowth_30d\t", out);
+		fputs("descendents\tdepth\tpath\n", out);
+	}
+	else if (query->format == BATCH_JSON)
+		fputs("[\n", out);
+}
+
+static void
+write_footer ()
+{
+	if (query->format == BATCH_JSON)
+		fputs(nwritten ? "\n]\n" : "]\n", out);
+}
+
+static void
+write_entry (node_s *node, long depth)
+{
+	char path[PATH_MAX];
+	int m;
+
+	node_path(node, path, sizeof(path));
+	switch (query->format) {
+	case BATCH_TEXT:
+		fprintf(out, "%11ld ", node->size);
+		for (m = 0; m < nmetrics; ++m)
+			fprintf(out, "%11llu ", metric_value(m, node));
+		if (nsnapshots > 1)
+			fprintf(out, "%+11lld ",
+				history_growth(node, history_window));
+		fprintf(out, "%s\n", path);
+		break;
+	case BATCH_TSV:
+		fprintf(out, "%ld\t", node->size);
+		for (m = 0; m < nmetrics; ++m)
+			fprintf(out, "%llu\t", metric_value(m, node));
+		if (nsnapshots > 1)
+			fprintf(out, "%lld\t%lld\t",
+				history_growth(node, HISTORY_SHORT_WINDOW),
+				history_growth(node, HISTORY_LONG_WINDOW));
+		fprintf(out, "%ld\t%ld\t%s\n", node->descendents, depth, path);
+		break;
+	case BATCH_JSON:
+		fputs(nwritten ? ",\n{\"path\": " : "{\"path\": ", out);
+		write_json_string(path);
+		fprintf(out, ", \"size\": %ld", node->size);
+		for (m = 0; m < nmetrics; ++m) {
+			fputs(", ", out);
+			write_json_string(metrics[m].name);
+			fprintf(out, ": %llu", metric_value(m, node));
+		}
+		if (nsnapshots > 1)
+			fprintf(out, ", \"growth_7d\": %lld, \"growth_30d\": %lld",
+				history_growth(node, HISTORY_SHORT_WINDOW),
+				history_growth(node, HISTORY_LONG_WINDOW));
+		fprintf(out, ", \"descendents\": %ld, \"depth\": %ld}",
+			node->descendents, depth);
+		break;
+	}
+	++nwritten;
+}
+
+static int
+cmp_size_desc (const void *aa, const void *bb)
+{
+	const node_s *a = *(const node_s **)aa;
+	const node_s *b = *(const node_s **)bb;
+	return (a->size < b->size) - (a->size > b->size);
+}
+
+/* Write a node and its descendents down to the query's depth, largest
+   first at each level.  A du-reported directory is never smaller than
+   anything in it, so nothing under a node that is too small is looked
+   at. */
+static void
+batch_tree (node_s *node, long depth)
+{
+	node_s **kids;
+	long i;
+
+	if ((TDU_SIZE_T)node->size < query->min_size) return;
+	if (node->parent && batch_matches(node)) write_entry(node, depth);
+	if (depth == query->depth) return;
+	node_load_children(node);
+	if (!node->nchildren) return;
+
+	kids = malloc(node->nchildren * sizeof(node_s *));
+	if (!kids) {
+		perror("batch_tree: malloc");
+		exit(1);
+	}
+	memcpy(kids, node->children, node->nchildren * sizeof(node_s *));
+	qsort(kids, node->nchildren, sizeof(node_s *), cmp_size_desc);
+	for (i = 0; i < node->nchildren; ++i)
+		batch_tree(kids[i], depth + 1);
+	free(kids);
+}
+
+/* The top entries are kept in a min-heap of at most query->top nodes,
+   smallest at the root, so that a node that can't make the list (and
+   everything under it) costs one comparison. */
+
+static node_s **heap;
+static long nheap;
+
+static void
+heap_sift_down (long i)
+{
+	node_s *t;
+	long c;
+
+	for (; (c = 2 * i + 1) < nheap; i = c) {
+		if (c + 1 < nheap && heap[c + 1]->size < heap[c]->size) ++c;
+		if (heap[i]->size <= heap[c]->size) break;
+		t = heap[i]; heap[i] = heap[c]; heap[c] = t;
+	}
+}
+
+static void
+heap_add (node_s *node)
+{
+	node_s *t;
+	long i, p;
+
+	if (nheap == query->top) {
+		heap[0] = node;
+		heap_sift_down(0);
+		return;
+	}
+	for (i = nheap++; i > 0; i = p) {
+		p = (i - 1) / 2;
+		if (heap[p]->size <= node->size) break;
+		t = heap[p]; heap[p] = heap[i]; heap[i] = t;
+	}
+	heap[i] = node;
+}
+
+static void
+batch_top_ (node_s *node, long depth)
+{
+	long i;
+
+	if ((TDU_SIZE_T)node->size < query->min_size) return;
+	if (nheap == query->top && node->size <= heap[0]->size) return;
+	if (depth > 0 && batch_matches(node)) heap_add(node);
+	if (depth == query->depth) return;
+	node_load_children(node);
+	for (i = 0; i < node->nchildren; ++i)
+		batch_top_(node->children[i], depth + 1);
+}
+
+static void
+batch_top (node_s *node)
+{
+	long i, n;
+
+	heap = malloc(query->top * sizeof(node_s *));
+	if (!heap) {
+		perror("batch_top: malloc");
+		exit(1);
+	}
+	nheap = 0;
+	batch_top_(node, 0);
+
+	/* heapsort: taking the smallest off the heap each time leaves the
+	   list biggest first */
+	for (n = nheap; nheap > 1; ) {
+		node_s *t = heap[0];
+		heap[0] = heap[--nheap];
+		heap[nheap] = t;
+		heap_sift_down(0);
+	}
+	for (i = 0; i < n; ++i) {
+		node_s *p;
+		long depth = 0;
+		for (p = heap[i]; p && p != node; p = p->parent)
+			++depth;
+		write_entry(heap[i], depth);
+	}
+	free(heap);
+}
+
+/* Find the starting node for a query. */
+static node_s *
+batch_start (node_s *root)
+{
+	if (query->path) return find_node_path(root, query->path);
+	if (root->nchildren == 1) return root->children[0];
+	return root;
+}
+
+/* Run a query against a tree, writing the results to out.  Returns an
+   exit status. */
+int
+batch_run (node_s *root, const batch_query_s *q, FILE *f)
+{
+	batch_query_s copy = *q;
+	node_s *node;
+	expr_s *expr = NULL;
+	char error[256];
+	long *ids, n, i;
+
+	query = &copy;
+	out = f;
+	nwritten = 0;
+	if (copy.depth == -2)
+		copy.depth = (copy.top > 0 || copy.where) ? -1 : 1;
+
+	if (copy.where && !(expr = expr_compile(copy.where, error,
+						sizeof(error)))) {
+		fprintf(stderr, "tdu: bad expression: %s\n", error);
+		return 1;
+	}
+	if (!(node = batch_start(root))) {
+		fprintf(stderr, "tdu: %s: no such path in the input\n",
+			q->path);
+		expr_free(expr);
+		return 1;
+	}
+
+	/* the whole expression is looked up first, in parallel, so that
+	   the walk below only has to look at a table */
+	if (expr) {
+		n = expr_select(expr, node, &ids);
+		nmatched = node_table_size;
+		if (!(matched = calloc(nmatched, 1))) {
+			perror("batch_run: calloc");
+			exit(1);
+		}
+		for (i = 0; i < n; ++i)
+			matched[ids[i]] = 1;
+		free(ids);
+		expr_free(expr);
+	}
+
+	write_header();
+	if (copy.top > 0)
+		batch_top(node);
+	else
+		batch_tree(node, 0);
+	write_footer();
+	free(matched);
+	matched = NULL;
+
+	if (fflush(out) || ferror(out)) {
+		perror("tdu: writing output");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,51 @@
+/*
+ * batch.h
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+/*****************************************************************************/
+
+#include "tdu.h"
+#include "node.h"
+
+/* output formats */
+#define BATCH_TEXT 0
+#define BATCH_TSV  1
+#define BATCH_JSON 2
+
+/* A query run without the interface: either the entries under a node
+   down to some depth, biggest first at each level, or the top largest
+   entries under it. */
+typedef struct batch_query {
+	const char *path;	/* where to start, or NULL for the top */
+	long top;		/* if > 0, list only this many largest */
+	long depth;		/* levels below the start, or -1 for all */
+	TDU_SIZE_T min_size;	/* leave out anything smaller */
+	const char *where;	/* leave out anything not matching (expr.c) */
+	int format;
+} batch_query_s;
+
+void batch_query_init (batch_query_s *query);
+int batch_parse_format (const char *s);
+int batch_run (node_s *root, const batch_query_s *query, FILE *out);
+
+/*****************************************************************************/
+#endif /* BATCH_H */
@@ -0,0 +1,285 @@
+/*
+ * bfs.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "walk.h"
+#include "search.h"
+#include "sizeindex.h"
+#include "perf.h"
+#include "bfs.h"
+#include "sketch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* With --progressive, --scan reads only the top directory before the
+   interface starts, and the rest a directory at a time, breadth first,
+   whenever no key is waiting.  The directories on screen, and what's
+   under them, are read ahead of the rest, and a directory is read at
+   once when it's expanded.
+
+   Until it has been read, a directory's size is an estimate: its own
+   size, plus what a directory at the same depth has been found to hold
+   directly (in files and its own entry), on average, plus as much again
+   for each of the subdirectories its link count says it has.  Reading
+   it replaces the estimate with what it holds and estimates for its
+   own subdirectories, and the directories above it change by the
+   difference.  A size with any estimate in it is provisional. */
+
+#define BFS_DEPTHS 64
+
+static unsigned char *unread = NULL;	/* by id */
+static long *pending = NULL;	/* unread directories at or under, by id */
+static long nalloc = 0;
+
+static long *queue = NULL;	/* ids of directories to read, in order */
+static long queue_head = 0, queue_tail = 0, queue_alloc = 0;
+static long nunread = 0;
+
+/* what directories at each depth hold directly */
+static TDU_SIZE_T depth_total[BFS_DEPTHS];
+static long depth_count[BFS_DEPTHS];
+
+static void
+bfs_reserve (long n)
+{
+	long alloc = nalloc ? nalloc : KIDSATATIME;
+
+	if (n <= nalloc) return;
+	while (alloc < n) alloc *= 2;
+	unread = realloc(unread, alloc);
+	pending = realloc(pending, alloc * sizeof(long));
+	if (!unread || !pending) {
+		perror("bfs_reserve: realloc");
+		exit(1);
+	}
+	memset(unread + nalloc, 0, alloc - nalloc);
+	memset(pending + nalloc, 0, (alloc - nalloc) * sizeof(long));
+	nalloc = alloc;
+}
+
+static int
+bfs_depth (const node_s *node)
+{
+	int depth = 0;
+
+	for (; node->parent; node = node->parent)
+		++depth;
+	return depth < BFS_DEPTHS ? depth : BFS_DEPTHS - 1;
+}
+
+/* What a directory at depth holds directly, on average, going by the
+   nearest depth above it that anything is known about. */
+static TDU_SIZE_T
+bfs_mean (int depth)
+{
+	for (; depth >= 0; --depth)
+		if (depth_count[depth])
+			return depth_total[depth] / depth_count[depth];
+	return 0;
+}
+
+static void
+bfs_pending_add (node_s *node, long n)
+{
+	for (; node; node = node->parent)
+		if (node->id >= 0 && node->id < nalloc)
+			pending[node->id] += n;
+}
+
+/* walk_defer_hook: leave a directory for later, with an estimate for a
+   size. */
+static bool
+bfs_defer (node_s *dir, const struct stat *st)
+{
+	int depth = bfs_depth(dir);
+	long subdirs = (st->st_nlink > 2) ? st->st_nlink - 2 : 0;
+
+	dir->size += bfs_mean(depth)
+		+ subdirs * bfs_mean(depth + 1 < BFS_DEPTHS ? depth + 1 : depth);
+
+	bfs_reserve(dir->id + 1);
+	unread[dir->id] = 1;
+	bfs_pending_add(dir, 1);
+	++nunread;
+
+	if (queue_tail == queue_alloc) {
+		queue_alloc = queue_alloc ? queue_alloc * 2 : KIDSATATIME;
+		if (!(queue = realloc(queue, queue_alloc * sizeof(long)))) {
+			perror("bfs_defer: realloc");
+			exit(1);
+		}
+	}
+	queue[queue_tail++] = dir->id;
+	return 1;
+}
+
+/* Go through the tree at dir, reading only the top directory for now. */
+node_s *
+bfs_start (const char *dir)
+{
+	walk_defer_hook = bfs_defer;
+	return walk_tree(dir);
+}
+
+long
+bfs_pending ()
+{
+	return nunread;
+}
+
+bool
+bfs_is_unread (const node_s *node)
+{
+	return (nunread && node->id >= 0 && node->id < nalloc
+		&& unread[node->id] && node_table[node->id] == node);
+}
+
+bool
+bfs_is_provisional (const node_s *node)
+{
+	return (nunread && node->id >= 0 && node->id < nalloc
+		&& pending[node->id] && node_table[node->id] == node);
+}
+
+/* Read a directory left for later. */
+void
+bfs_load (node_s *node)
+{
+	char path[PATH_MAX];
+	struct stat st;
+	TDU_SIZE_T old = node->size, direct;
+	long descendents = node->descendents;
+	node_s *p;
+	int len, depth;
+	long i;
+
+	if (!bfs_is_unread(node)) return;
+	unread[node->id] = 0;
+	bfs_pending_add(node, -1);
+	--nunread;
+
+	/* nothing may be looking at node_table while it grows */
+	search_index_invalidate();
+	size_index_invalidate();
+
+	len = walk_path(node, path, sizeof(path));
+	if (len < sizeof(path) && !lstat(path, &st)) {
+		walk_quiet = 1;
+		node->size = walk_blocks(&st);
+		walk_dir(node, path, len);
+
+		direct = walk_blocks(&st);
+		for (i = 0; i < node->nchildren; ++i)
+			if (!bfs_is_unread(node->children[i]))
+				direct += node->children[i]->size;
+		depth = bfs_depth(node);
+		depth_total[depth] += direct;
+		++depth_count[depth];
+	}
+	for (p = node->parent; p; p = p->parent) {
+		p->size += node->size - old;
+		p->descendents += node->descendents - descendents;
+	}
+	sketch_merge_up(node);
+	if (!nunread)
+		search_index_start();
+}
+
+/* A node is about to be freed: forget about any directories under it
+   that haven't been read. */
+void
+bfs_forget (node_s *node)
+{
+	long n;
+
+	if (!(nunread && node->id >= 0 && node->id < nalloc)) return;
+	if ((n = pending[node->id])) {
+		bfs_pending_add(node, -n);
+		nunread -= n;
+	}
+}
+
+/* The shallowest directory under node not read yet, or NULL.  Only
+   provisional directories can have one under them. */
+static node_s *
+bfs_find (node_s *node)
+{
+	static node_s **fifo = NULL;
+	static long alloc = 0;
+	long head = 0, tail = 0, i;
+
+	if (!bfs_is_provisional(node)) return NULL;
+	if (bfs_is_unread(node)) return node;
+	for (;;) {
+		for (i = 0; i < node->nchildren; ++i) {
+			node_s *child = node->children[i];
+			if (!bfs_is_provisional(child)) continue;
+			if (bfs_is_unread(child)) return child;
+			if (tail == alloc) {
+				alloc = alloc ? alloc * 2 : KIDSATATIME;
+				fifo = realloc(fifo, alloc * sizeof(node_s *));
+				if (!fifo) {
+					perror("bfs_find: realloc");
+					exit(1);
+				}
+			}
+			fifo[tail++] = child;
+		}
+		if (head == tail) return NULL;
+		node = fifo[head++];
+	}
+}
+
+/* Read directories for about ms milliseconds: first those under the
+   visible nodes, in order, then the rest, breadth first.  Returns the
+   number read. */
+long
+bfs_step (double ms, node_s **visible, long nvisible)
+{
+	double deadline = perf_clock() + ms;
+	node_s *node;
+	long n = 0, i;
+
+	for (i = 0; i < nvisible && nunread; ++i) {
+		while (perf_clock() < deadline
+		       && (node = bfs_find(visible[i]))) {
+			bfs_load(node);
+			++n;
+		}
+	}
+	while (nunread && queue_head < queue_tail
+	       && perf_clock() < deadline) {
+		long id = queue[queue_head++];
+		node = node_table[id];
+		if (node && bfs_is_unread(node)) {
+			bfs_load(node);
+			++n;
+		}
+	}
+	if (queue_head == queue_tail)
+		queue_head = queue_tail = 0;
+	return n;
+}
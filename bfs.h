@@ -0,0 +1,41 @@
+/*
+ * bfs.h
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#ifndef BFS_H
+#define BFS_H
+/*****************************************************************************/
+
+#include "tdu.h"
+#include "node.h"
+
+/* how long the interface lets the scan run between looks at the keys */
+#define BFS_SLICE_MS 20
+
+node_s *bfs_start (const char *dir);
+long bfs_pending (void);
+bool bfs_is_unread (const node_s *node);
+bool bfs_is_provisional (const node_s *node);
+void bfs_load (node_s *node);
+void bfs_forget (node_s *node);
+long bfs_step (double ms, node_s **visible, long nvisible);
+
+/*****************************************************************************/
+#endif /* BFS_H */
@@ -0,0 +1,172 @@
+/*
+ * export.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "metric.h"
+#include "spill.h"
+#include "export.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* The tree is exported for loading into a database as one file per
+   column, a row per node, each parent before its children:
+
+	id.i64		the node's id, unique within the export
+	parent.i64	its parent's id, or -1 at the top
+	size.u64	its size, in du's units, as shown
+	descendents.i64
+	depth.i32	0 at the top
+	name.off	where each name starts in name.str, and after the
+			last one where it ends: one more than there are rows
+	name.str	the names, one after another, not terminated
+	metric-NAME.u64	one for each metric column
+
+   Numbers are little-endian.  Only names are written, never whole
+   pathnames, and each column is written as the tree is walked, so
+   nothing but the files' buffers is kept.  columns.txt lists the files
+   and the number of rows. */
+
+#define EXPORT_BUFFER (1 << 16)
+
+typedef struct column {
+	FILE *f;
+	char path[PATH_MAX];
+} column_s;
+
+enum { COL_ID, COL_PARENT, COL_SIZE, COL_DESCENDENTS, COL_DEPTH,
+       COL_NAME_OFF, COL_NAME_STR, NCOLUMNS };
+
+static const char *column_files[NCOLUMNS] = {
+	"id.i64", "parent.i64", "size.u64", "descendents.i64", "depth.i32",
+	"name.off", "name.str",
+};
+
+static column_s columns[NCOLUMNS + METRIC_MAX];
+static unsigned long long name_offset;
+static long rows;
+
+static void
+column_open (column_s *c, const char *dir, const char *file)
+{
+	snprintf(c->path, sizeof(c->path), "%s/%s", dir, file);
+	if (!(c->f = fopen(c->path, "w"))) {
+		perror(c->path);
+		exit(1);
+	}
+	setvbuf(c->f, NULL, _IOFBF, EXPORT_BUFFER);
+}
+
+static void
+column_put (column_s *c, unsigned long long value, int bytes)
+{
+	unsigned char buf[8];
+	int i;
+
+	for (i = 0; i < bytes; ++i, value >>= 8)
+		buf[i] = value & 0xff;
+	fwrite(buf, 1, bytes, c->f);
+}
+
+static int
+column_close (column_s *c)
+{
+	if (ferror(c->f) | fclose(c->f)) {
+		perror(c->path);
+		return 1;
+	}
+	return 0;
+}
+
+static void
+export_node (node_s *node, long parent, int depth)
+{
+	long i;
+	int m;
+
+	if (node->descendents < 0) fix_tree_descendents(node);
+	column_put(&columns[COL_ID], node->id, 8);
+	column_put(&columns[COL_PARENT], parent, 8);
+	column_put(&columns[COL_SIZE], node->size, 8);
+	column_put(&columns[COL_DESCENDENTS], node->descendents, 8);
+	column_put(&columns[COL_DEPTH], depth, 4);
+	column_put(&columns[COL_NAME_OFF], name_offset, 8);
+	fputs(node->name, columns[COL_NAME_STR].f);
+	name_offset += strlen(node->name);
+	for (m = 0; m < nmetrics; ++m)
+		column_put(&columns[NCOLUMNS + m], metric_value(m, node), 8);
+	++rows;
+
+	node_load_children(node);
+	for (i = 0; i < node->nchildren; ++i)
+		export_node(node->children[i], node->id, depth + 1);
+
+	/* done with what's under it, which can be written out again
+	   rather than all be read in by the time the export is over */
+	if (tdu_memory_limit && node_memory > tdu_memory_limit)
+		spill_node(node);
+}
+
+/* Write the tree under root (but not root itself) into dir, creating it
+   if need be.  Returns an exit status. */
+int
+export_columns (node_s *root, const char *dir)
+{
+	char file[NAME_MAX + 1];
+	column_s list;
+	int i, failed = 0;
+	long j;
+
+	if (mkdir(dir, 0777) && errno != EEXIST) {
+		perror(dir);
+		return 1;
+	}
+	for (i = 0; i < NCOLUMNS; ++i)
+		column_open(&columns[i], dir, column_files[i]);
+	for (i = 0; i < nmetrics; ++i) {
+		snprintf(file, sizeof(file), "metric-%s.u64", metrics[i].name);
+		column_open(&columns[NCOLUMNS + i], dir, file);
+	}
+
+	name_offset = 0;
+	rows = 0;
+	node_load_children(root);
+	for (j = 0; j < root->nchildren; ++j)
+		export_node(root->children[j], -1, 0);
+	column_put(&columns[COL_NAME_OFF], name_offset, 8);
+
+	for (i = 0; i < NCOLUMNS + nmetrics; ++i)
+		failed |= column_close(&columns[i]);
+
+	column_open(&list, dir, "columns.txt");
+	fprintf(list.f, "rows\t%ld\n", rows);
+	for (i = 0; i < NCOLUMNS; ++i)
+		fprintf(list.f, "column\t%s\n", column_files[i]);
+	for (i = 0; i < nmetrics; ++i)
+		fprintf(list.f, "column\tmetric-%s.u64\n", metrics[i].name);
+	failed |= column_close(&list);
+	return failed;
+}
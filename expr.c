@@ -0,0 +1,489 @@
+/*
+ * expr.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "metric.h"
+#include "history.h"
+#include "slice.h"
+#include "expr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <limits.h>
+#include <fnmatch.h>
+
+/* A filter expression, such as
+       dir && descendents > 100k && size < 1G
+   or  name ~ "*.log" && (depth <= 6 || growth > 1G)
+   is compiled once into a short program (see expr.h), which is then
+   run over an array of node ids cut into slices, a thread to a slice
+   (see slice.c).
+
+   A field is compared with <, <=, >, >=, == or != to a number, which
+   for size, growth and metric columns is read as parse_size() reads
+   one (1G is a gigabyte), and for counts may end in k, M or G for
+   thousands, millions or billions.  name and path are matched to a
+   glob with ~ (or !~), or compared as they are with == and !=.  dir
+   and file stand alone.  && binds tighter than ||, and ! tighter than
+   either. */
+
+typedef struct parser {
+	const char *p;
+	expr_s *expr;
+	char *error;
+	int size;
+	bool failed;
+} parser_s;
+
+static void parse_or (parser_s *ps);
+
+static void
+parse_fail (parser_s *ps, const char *fmt, ...)
+{
+	va_list ap;
+
+	if (ps->failed) return;
+	ps->failed = 1;
+	va_start(ap, fmt);
+	vsnprintf(ps->error, ps->size, fmt, ap);
+	va_end(ap);
+}
+
+static expr_op_s *
+emit (parser_s *ps, int code)
+{
+	expr_op_s *op;
+
+	if (ps->expr->nops == EXPR_MAX_OPS) {
+		parse_fail(ps, "expression too long");
+		return NULL;
+	}
+	op = &ps->expr->ops[ps->expr->nops++];
+	memset(op, 0, sizeof(*op));
+	op->code = code;
+	return op;
+}
+
+static void
+skip_space (parser_s *ps)
+{
+	while (isspace((unsigned char)*ps->p)) ++ps->p;
+}
+
+/* Take s if it comes next. */
+static bool
+accept (parser_s *ps, const char *s)
+{
+	skip_space(ps);
+	if (strncmp(ps->p, s, strlen(s))) return 0;
+	ps->p += strlen(s);
+	return 1;
+}
+
+static bool
+is_word_char (char c)
+{
+	return isalnum((unsigned char)c) || c == '_' || c == '-' || c == '.';
+}
+
+/* A field name, a number or an unquoted pattern: whatever runs up to
+   the next space, parenthesis or operator. */
+static bool
+parse_word (parser_s *ps, char *buf, int size, bool pattern)
+{
+	int len = 0;
+
+	skip_space(ps);
+	while (*ps->p && (pattern
+			  ? !isspace((unsigned char)*ps->p)
+			    && !strchr("()&|", *ps->p)
+			  : is_word_char(*ps->p))) {
+		if (len < size - 1) buf[len++] = *ps->p;
+		++ps->p;
+	}
+	buf[len] = '\0';
+	return len > 0;
+}
+
+/* A pattern, either in double quotes, with \ taking the next
+   character as it is, or bare. */
+static bool
+parse_pattern (parser_s *ps, char *buf, int size)
+{
+	int len = 0;
+
+	skip_space(ps);
+	if (*ps->p != '"')
+		return parse_word(ps, buf, size, 1);
+	for (++ps->p; *ps->p && *ps->p != '"'; ++ps->p) {
+		if (*ps->p == '\\' && ps->p[1]) ++ps->p;
+		if (len < size - 1) buf[len++] = *ps->p;
+	}
+	buf[len] = '\0';
+	if (*ps->p != '"') {
+		parse_fail(ps, "missing \"");
+		return 0;
+	}
+	++ps->p;
+	return 1;
+}
+
+static void
+parse_number (parser_s *ps, expr_op_s *op)
+{
+	char word[64];
+	const char *s = word;
+	TDU_SIZE_T size;
+	double value;
+	char *end;
+	bool negative = 0;
+
+	skip_space(ps);
+	if (*ps->p == '-') {
+		negative = 1;
+		++ps->p;
+	}
+	if (!parse_word(ps, word, sizeof(word), 0)) {
+		parse_fail(ps, "number expected at \"%s\"", ps->p);
+		return;
+	}
+	if (op->field == EXPR_SIZE || op->field == EXPR_GROWTH
+	    || op->field == EXPR_METRIC) {
+		if (!parse_size(s, &size)) {
+			parse_fail(ps, "bad size \"%s\"", word);
+			return;
+		}
+		op->value = size;
+	}
+	else {
+		value = strtod(s, &end);
+		if (*end == 'k' || *end == 'K') value *= 1e3;
+		else if (*end == 'M') value *= 1e6;
+		else if (*end == 'G') value *= 1e9;
+		else if (*end) end = word;	/* not a suffix */
+		if (end == s || (*end && end[1])) {
+			parse_fail(ps, "bad number \"%s\"", word);
+			return;
+		}
+		op->value = value;
+	}
+	if (negative) op->value = -op->value;
+}
+
+/* A field, compared with something unless it stands alone. */
+static void
+parse_term (parser_s *ps)
+{
+	static const struct {
+		const char *name;
+		int field;
+	} fields[] = {
+		{ "size", EXPR_SIZE }, { "depth", EXPR_DEPTH },
+		{ "descendents", EXPR_DESCENDENTS },
+		{ "descendants", EXPR_DESCENDENTS },
+		{ "children", EXPR_CHILDREN }, { "growth", EXPR_GROWTH },
+		{ "name", EXPR_NAME }, { "path", EXPR_PATH },
+		{ "dir", EXPR_DIR }, { "file", EXPR_FILE },
+	};
+	static const struct {
+		const char *op;
+		int code;
+	} relops[] = {	/* longest first */
+		{ "<=", EXPR_LE }, { ">=", EXPR_GE }, { "==", EXPR_EQ },
+		{ "!=", EXPR_NE }, { "!~", EXPR_NOMATCH }, { "<", EXPR_LT },
+		{ ">", EXPR_GT }, { "~", EXPR_MATCH }, { "=", EXPR_EQ },
+	};
+	char word[256];
+	expr_op_s op, *o;
+	int i, m = -1;
+
+	if (!parse_word(ps, word, sizeof(word), 0)) {
+		parse_fail(ps, *ps->p ? "unexpected \"%s\"" : "unexpected end",
+			   ps->p);
+		return;
+	}
+	memset(&op, 0, sizeof(op));
+	for (i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i)
+		if (!strcmp(word, fields[i].name)) break;
+	if (i < sizeof(fields) / sizeof(fields[0])) {
+		op.field = fields[i].field;
+	}
+	else {
+		for (m = 0; m < nmetrics; ++m)
+			if (!strcmp(word, metrics[m].name)) break;
+		if (m == nmetrics) {
+			parse_fail(ps, "no field called \"%s\"", word);
+			return;
+		}
+		op.field = EXPR_METRIC;
+		op.metric = m;
+	}
+	if (op.field == EXPR_DIR || op.field == EXPR_FILE) {
+		if ((o = emit(ps, EXPR_IS))) o->field = op.field;
+		return;
+	}
+
+	for (i = 0; i < sizeof(relops) / sizeof(relops[0]); ++i)
+		if (accept(ps, relops[i].op)) break;
+	if (i == sizeof(relops) / sizeof(relops[0])) {
+		parse_fail(ps, "comparison expected after %s", word);
+		return;
+	}
+	op.code = relops[i].code;
+
+	if (op.field == EXPR_NAME || op.field == EXPR_PATH) {
+		if (op.code != EXPR_MATCH && op.code != EXPR_NOMATCH
+		    && op.code != EXPR_EQ && op.code != EXPR_NE) {
+			parse_fail(ps, "%s takes ~, !~, == or !=", word);
+			return;
+		}
+		if (!parse_pattern(ps, word, sizeof(word))) {
+			parse_fail(ps, "pattern expected at \"%s\"", ps->p);
+			return;
+		}
+		if (!(op.pattern = strdup(word))) {
+			perror("parse_term: strdup");
+			exit(1);
+		}
+		if (op.field == EXPR_PATH) ps->expr->needs_path = 1;
+	}
+	else {
+		if (op.code == EXPR_MATCH || op.code == EXPR_NOMATCH) {
+			parse_fail(ps, "only name and path take ~");
+			return;
+		}
+		parse_number(ps, &op);
+		if (op.field == EXPR_DEPTH) ps->expr->needs_depth = 1;
+	}
+	if ((o = emit(ps, op.code))) {
+		*o = op;
+		op.pattern = NULL;
+	}
+	free(op.pattern);
+}
+
+static void
+parse_unary (parser_s *ps)
+{
+	skip_space(ps);
+	if (*ps->p == '!' && ps->p[1] != '=' && ps->p[1] != '~') {
+		++ps->p;
+		parse_unary(ps);
+		emit(ps, EXPR_NOT);
+	}
+	else if (accept(ps, "(")) {
+		parse_or(ps);
+		if (!accept(ps, ")"))
+			parse_fail(ps, "missing )");
+	}
+	else {
+		parse_term(ps);
+	}
+}
+
+static void
+parse_and (parser_s *ps)
+{
+	parse_unary(ps);
+	while (!ps->failed && accept(ps, "&&")) {
+		parse_unary(ps);
+		emit(ps, EXPR_AND);
+	}
+}
+
+static void
+parse_or (parser_s *ps)
+{
+	parse_and(ps);
+	while (!ps->failed && accept(ps, "||")) {
+		parse_and(ps);
+		emit(ps, EXPR_OR);
+	}
+}
+
+/* Compile an expression.  Returns NULL, having written why into error,
+   if it can't be. */
+expr_s *
+expr_compile (const char *text, char *error, int size)
+{
+	parser_s ps;
+
+	ps.p = text;
+	ps.error = error;
+	ps.size = size;
+	ps.failed = 0;
+	if (!(ps.expr = calloc(1, sizeof(expr_s)))) {
+		perror("expr_compile: calloc");
+		exit(1);
+	}
+	parse_or(&ps);
+	skip_space(&ps);
+	if (!ps.failed && *ps.p)
+		parse_fail(&ps, "unexpected \"%s\"", ps.p);
+	if (ps.failed) {
+		expr_free(ps.expr);
+		return NULL;
+	}
+	return ps.expr;
+}
+
+void
+expr_free (expr_s *expr)
+{
+	int i;
+
+	if (!expr) return;
+	for (i = 0; i < expr->nops; ++i)
+		free(expr->ops[i].pattern);
+	free(expr);
+}
+
+/* How many names deep a node is, the top of the tree being 0.  A
+   folded chain (see fold_tree()) counts for each of its names. */
+static long
+expr_depth (const node_s *node)
+{
+	const char *s;
+	long depth = -1;
+
+	for (; node && node->parent; node = node->parent) {
+		++depth;
+		for (s = node->name; (s = strchr(s, '/')); ++s)
+			++depth;
+	}
+	return depth;
+}
+
+static long long
+expr_value (const expr_op_s *op, node_s *node, long depth)
+{
+	switch (op->field) {
+	case EXPR_SIZE:		return node->size;
+	case EXPR_DEPTH:	return depth;
+	case EXPR_DESCENDENTS:	return node->descendents;
+	case EXPR_CHILDREN:	return node->nchildren;
+	case EXPR_GROWTH:	return history_growth(node, history_window);
+	case EXPR_METRIC:	return metric_value(op->metric, node);
+	}
+	return 0;
+}
+
+/* Does node match? */
+bool
+expr_match (const expr_s *expr, node_s *node)
+{
+	bool stack[EXPR_MAX_OPS];
+	char path[PATH_MAX];
+	const char *s, *name;
+	long depth = 0;
+	long long v;
+	int sp = 0, i;
+
+	if (expr->needs_path) node_path(node, path, sizeof(path));
+	if (expr->needs_depth) depth = expr_depth(node);
+	/* a folded chain is named for its last directory */
+	name = (s = strrchr(node->name, '/')) ? s + 1 : node->name;
+
+	for (i = 0; i < expr->nops; ++i) {
+		const expr_op_s *op = &expr->ops[i];
+
+		switch (op->code) {
+		case EXPR_AND:
+			--sp;
+			stack[sp - 1] = stack[sp - 1] && stack[sp];
+			continue;
+		case EXPR_OR:
+			--sp;
+			stack[sp - 1] = stack[sp - 1] || stack[sp];
+			continue;
+		case EXPR_NOT:
+			stack[sp - 1] = !stack[sp - 1];
+			continue;
+		case EXPR_IS:
+			stack[sp++] = ((node->nchildren
+					|| node_has_unloaded_children(node))
+				       == (op->field == EXPR_DIR));
+			continue;
+		}
+		if (op->pattern) {
+			s = (op->field == EXPR_PATH) ? path : name;
+			if (op->code == EXPR_MATCH || op->code == EXPR_NOMATCH)
+				stack[sp++] = (!fnmatch(op->pattern, s, 0)
+					       == (op->code == EXPR_MATCH));
+			else
+				stack[sp++] = (!strcmp(op->pattern, s)
+					       == (op->code == EXPR_EQ));
+			continue;
+		}
+		v = expr_value(op, node, depth);
+		switch (op->code) {
+		case EXPR_LT: stack[sp++] = v < op->value; break;
+		case EXPR_LE: stack[sp++] = v <= op->value; break;
+		case EXPR_GT: stack[sp++] = v > op->value; break;
+		case EXPR_GE: stack[sp++] = v >= op->value; break;
+		case EXPR_EQ: stack[sp++] = v == op->value; break;
+		case EXPR_NE: stack[sp++] = v != op->value; break;
+		}
+	}
+	return sp ? stack[sp - 1] : 1;
+}
+
+/* Keep a slice's matches, in place at its start. */
+static void
+expr_slice (slice_s *slice)
+{
+	const expr_s *expr = slice->arg;
+	long i;
+
+	for (i = 0; i < slice->n; ++i)
+		if (expr_match(expr, node_table[slice->ids[i]]))
+			slice->ids[slice->nresults++] = slice->ids[i];
+}
+
+/* slice_ids(): every node */
+static bool
+expr_any (const node_s *node)
+{
+	return 1;
+}
+
+/* Find the nodes at or under root that match.  Returns how many, with
+   their ids in ascending order in *ids, which the caller frees. */
+long
+expr_select (const expr_s *expr, node_s *root, long **ids)
+{
+	slice_s slices[SLICE_MAX_THREADS];
+	long n, k;
+	int nslices, t;
+
+	n = slice_ids(root, expr_any, ids);
+	nslices = slice_run(*ids, n, expr_slice, (void *)expr, slices);
+
+	/* each slice's matches are at its start; close up the gaps */
+	for (k = t = 0; t < nslices; ++t) {
+		memmove(*ids + k, slices[t].ids, slices[t].nresults * sizeof(long));
+		k += slices[t].nresults;
+	}
+	return k;
+}
@@ -0,0 +1,70 @@
+/*
+ * expr.h
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#ifndef EXPR_H
+#define EXPR_H
+/*****************************************************************************/
+
+#include "tdu.h"
+#include "node.h"
+
+/* the longest program an expression compiles to */
+#define EXPR_MAX_OPS 256
+
+/* what an operation does: compare a field, match a pattern, or combine
+   the results of earlier operations */
+enum {
+	EXPR_LT, EXPR_LE, EXPR_GT, EXPR_GE, EXPR_EQ, EXPR_NE,
+	EXPR_MATCH, EXPR_NOMATCH, EXPR_IS,
+	EXPR_AND, EXPR_OR, EXPR_NOT
+};
+
+/* what it looks at */
+enum {
+	EXPR_SIZE, EXPR_DEPTH, EXPR_DESCENDENTS, EXPR_CHILDREN,
+	EXPR_GROWTH, EXPR_METRIC, EXPR_NAME, EXPR_PATH, EXPR_DIR, EXPR_FILE
+};
+
+typedef struct expr_op {
+	int code;
+	int field;
+	int metric;		/* which, for EXPR_METRIC */
+	long long value;	/* compared against */
+	char *pattern;		/* glob, for EXPR_MATCH and EXPR_NOMATCH */
+} expr_op_s;
+
+/* An expression is compiled to a program run on a stack of truth
+   values, in postfix order: "size > 1G && dir" is [size > 1G] [dir]
+   [and]. */
+typedef struct expr {
+	expr_op_s ops[EXPR_MAX_OPS];
+	int nops;
+	bool needs_path;
+	bool needs_depth;
+} expr_s;
+
+expr_s *expr_compile (const char *text, char *error, int size);
+void expr_free (expr_s *expr);
+bool expr_match (const expr_s *expr, node_s *node);
+long expr_select (const expr_s *expr, node_s *root, long **ids);
+
+/*****************************************************************************/
+#endif /* EXPR_H */
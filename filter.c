@@ -0,0 +1,264 @@
+/*
+ * filter.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "search.h"
+#include "filter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fnmatch.h>
+#include <glib.h>
+
+/* A pattern is either a shell glob (if it has any of * ? [), matched
+   against the whole name, or a substring, matched as search_find()
+   would.  A pattern containing a slash is matched against the pathname.
+
+   The set of nodes matching the last pattern is kept, and when the new
+   pattern can only match a subset of it -- as when more text is typed
+   onto a substring -- the new set is picked out of the old one instead
+   of being looked up again. */
+
+static char *last_pattern = NULL;
+static long *last_ids = NULL;
+static long last_nids = 0;
+
+bool
+filter_is_glob (const char *pattern)
+{
+	return strpbrk(pattern, "*?[") != NULL;
+}
+
+bool
+filter_match_node (node_s *node, const char *pattern)
+{
+	char path[PATH_MAX];
+	const char *name;
+
+	if (!(node && node->parent)) return 0;
+	if (!filter_is_glob(pattern))
+		return search_match_node(node, pattern);
+	if (!strchr(pattern, '/')) {
+		/* a folded chain (see fold_tree()) is named for its last
+		   directory */
+		name = strrchr(node->name, '/');
+		return !fnmatch(pattern, name ? name + 1 : node->name, 0);
+	}
+	if (node_path(node, path, sizeof(path)) >= sizeof(path))
+		return 0;
+	return !fnmatch(pattern, path, 0);
+}
+
+/* Can everything matching pattern also match old? */
+static bool
+filter_refines (const char *old, const char *pattern)
+{
+	int len = strlen(old);
+
+	if (strchr(old, '/') || strchr(pattern, '/'))
+		return 0;
+	if (!filter_is_glob(old)) {
+		/* a glob that starts with the text only matches names
+		   starting with it */
+		return (filter_is_glob(pattern)
+			? !strncmp(pattern, old, len)
+			: strstr(pattern, old) != NULL);
+	}
+	/* P*X only matches what P* matches */
+	return (!strchr(old, '[') && !strncmp(pattern, old, len)
+		&& old[len - 1] == '*' && (len < 2 || old[len - 2] != '\\'));
+}
+
+/* The longest run of plain characters in the last component of a glob,
+   which any name it matches has to contain. */
+static void
+glob_literal (const char *pattern, char *buf, int size)
+{
+	const char *p = strrchr(pattern, '/');
+	int len = 0, best = 0;
+
+	*buf = '\0';
+	for (p = p ? p + 1 : pattern; ; ++p) {
+		if (*p && !strchr("*?[\\", *p)) {
+			++len;
+			continue;
+		}
+		if (len > best && len < size) {
+			best = len;
+			memcpy(buf, p - len, len);
+			buf[len] = '\0';
+		}
+		len = 0;
+		if (*p == '\\' && p[1]) {
+			++p;		/* escaped character: start over after it */
+		}
+		else if (*p == '[') {
+			p += (p[1] == ']') ? 2 : 1;
+			while (*p && *p != ']') ++p;
+		}
+		if (!*p) break;
+	}
+}
+
+/* Forget the last pattern, so that the next one is looked up afresh. */
+void
+filter_reset ()
+{
+	free(last_pattern);
+	free(last_ids);
+	last_pattern = NULL;
+	last_ids = NULL;
+	last_nids = 0;
+}
+
+/* Find the ids of the nodes matching pattern, in ascending order.
+   Returns how many.  The list belongs to the filter and stays valid
+   until the next call. */
+long
+filter_match (const char *pattern, long **ids)
+{
+	long *candidates;
+	long ncandidates, i, n;
+	char literal[PATH_MAX];
+
+	if (last_pattern && filter_refines(last_pattern, pattern)) {
+		candidates = last_ids;
+		ncandidates = last_nids;
+		last_ids = NULL;
+	}
+	else if (!filter_is_glob(pattern)) {
+		filter_reset();
+		n = search_find(pattern, 0, &last_ids);
+		last_nids = n;
+		last_pattern = strdup(pattern);
+		*ids = last_ids;
+		return n;
+	}
+	else {
+		glob_literal(pattern, literal, sizeof(literal));
+		ncandidates = search_candidates(literal, &candidates);
+	}
+
+	/* the candidates list is filtered in place */
+	for (i = n = 0; i < ncandidates; ++i)
+		if (filter_match_node(node_table[candidates[i]], pattern))
+			candidates[n++] = candidates[i];
+
+	filter_reset();
+	last_pattern = strdup(pattern);
+	last_ids = candidates;
+	last_nids = n;
+	*ids = last_ids;
+	return n;
+}
+
+/* binary search of a sorted list of ids */
+static bool
+ids_contain (const long *ids, long n, long id)
+{
+	long lo = 0, hi = n;
+	while (lo < hi) {
+		long mid = (lo + hi) / 2;
+		if (ids[mid] < id) lo = mid + 1;
+		else if (ids[mid] > id) hi = mid;
+		else return 1;
+	}
+	return 0;
+}
+
+/* Set the sizes and descendent counts in a view: a matching node keeps
+   its own size, anything else gets the total of the matches inside it,
+   and descendents counts the matches at or below each node. */
+static void
+filter_view_sums (node_s *view, const long *ids, long n)
+{
+	bool matched = ids_contain(ids, n, view->id);
+	TDU_SIZE_T size = 0;
+	long count = matched;
+	int i;
+
+	for (i = 0; i < view->nchildren; ++i) {
+		filter_view_sums(view->children[i], ids, n);
+		size += view->children[i]->size;
+		count += view->children[i]->descendents;
+	}
+	view->size = matched ? node_table[view->id]->size : size;
+	view->descendents = count;
+}
+
+/* Build a view of the tree under root holding only the matching nodes
+   (listed by id, in ascending order) and the directories leading to
+   them, and return its root.  The view is fully expanded. */
+node_s *
+filter_view (node_s *root, const long *ids, long n)
+{
+	GHashTable *views;
+	node_s *view;
+	long i;
+
+	views = g_hash_table_new(g_direct_hash, g_direct_equal);
+	view = new_view_node(root);
+	g_hash_table_insert(views, root, view);
+
+	for (i = 0; i < n; ++i) {
+		node_s *node = node_table[ids[i]];
+		node_s *child = NULL;
+		node_s *p;
+
+		for (p = node; p && p != root; p = p->parent)
+			;
+		if (!p) continue;	/* not under root */
+
+		/* link the node in, along with as many of its ancestors as
+		   aren't in the view yet */
+		for (; node; node = node->parent) {
+			node_s *v = g_hash_table_lookup(views, node);
+			bool found = (v != NULL);
+			if (!found) {
+				v = new_view_node(node);
+				g_hash_table_insert(views, node, v);
+			}
+			if (child) add_child(v, child);
+			if (found) break;
+			child = v;
+		}
+	}
+	g_hash_table_destroy(views);
+
+	cleanup_tree(view);
+	filter_view_sums(view, ids, n);
+	expand_tree(view, -1);
+	return view;
+}
+
+void
+filter_free_view (node_s *view)
+{
+	int i;
+	if (!view) return;
+	for (i = 0; i < view->nchildren; ++i)
+		filter_free_view(view->children[i]);
+	node_rollup_free(view);
+	free(view->children);
+	free(view);
+}
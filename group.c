@@ -0,0 +1,160 @@
+/*
+ * group.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "group.h"
+#include "slice.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+/* Files are grouped by extension in one pass over an array of their
+   ids (see slice.c): each thread totals its slice into a hash table of
+   its own, and the tables are merged at the end.
+   Directories only count through the files in them.
+
+   du's output says nothing about owners or groups, so extension is the
+   only thing there is to group by. */
+
+#define GROUP_NONE "(none)"
+
+static const char *
+extension (const char *name)
+{
+	const char *dot = strrchr(name, '.');
+	/* .profile is a name, not an extension */
+	return (dot && dot != name && dot[1]) ? dot + 1 : GROUP_NONE;
+}
+
+/* Add size and files to key's group in a table mapping keys to 1 +
+   indexes into *groups. */
+static void
+group_add (GHashTable *table, group_s **groups, long *ngroups,
+	   const char *key, TDU_SIZE_T size, long files)
+{
+	long i = (long)g_hash_table_lookup(table, key);
+
+	if (!i) {
+		if (!(*ngroups & (*ngroups - 1))) {
+			*groups = realloc(*groups, (*ngroups ? *ngroups * 2 : 16)
+					  * sizeof(group_s));
+			if (!*groups) {
+				perror("group_add: realloc");
+				exit(1);
+			}
+		}
+		(*groups)[*ngroups].key = key;
+		(*groups)[*ngroups].size = 0;
+		(*groups)[*ngroups].files = 0;
+		i = ++*ngroups;
+		g_hash_table_insert(table, (gpointer)key, (gpointer)i);
+	}
+	(*groups)[i - 1].size += size;
+	(*groups)[i - 1].files += files;
+}
+
+/* Total a slice's files into groups of its own. */
+static void
+group_slice (slice_s *slice)
+{
+	GHashTable *table = g_hash_table_new(g_str_hash, g_str_equal);
+	group_s *groups = NULL;
+	long i;
+
+	for (i = 0; i < slice->n; ++i) {
+		node_s *node = node_table[slice->ids[i]];
+		group_add(table, &groups, &slice->nresults,
+			  extension(node->name), node->size, 1);
+	}
+	g_hash_table_destroy(table);
+	slice->results = groups;
+}
+
+/* slice_ids(): the files, which directories only count through */
+static bool
+group_is_file (const node_s *node)
+{
+	return !node->nchildren && !node_has_unloaded_children(node);
+}
+
+static int
+group_cmp_size (const void *aa, const void *bb)
+{
+	const group_s *a = aa;
+	const group_s *b = bb;
+	if (a->size != b->size) return (a->size < b->size) - (a->size > b->size);
+	return strcmp(a->key, b->key);
+}
+
+/* Total the files at or under root by extension.  Returns the number
+   of groups, largest first, in *groups, which the caller frees. */
+long
+group_by_extension (node_s *root, group_s **groups)
+{
+	slice_s slices[SLICE_MAX_THREADS];
+	GHashTable *table;
+	long *ids;
+	long n, ngroups = 0, j;
+	int nslices, t;
+
+	n = slice_ids(root, group_is_file, &ids);
+	nslices = slice_run(ids, n, group_slice, NULL, slices);
+	free(ids);
+
+	*groups = NULL;
+	table = g_hash_table_new(g_str_hash, g_str_equal);
+	for (t = 0; t < nslices; ++t) {
+		group_s *g = slices[t].results;
+		for (j = 0; j < slices[t].nresults; ++j)
+			group_add(table, groups, &ngroups,
+				  g[j].key, g[j].size, g[j].files);
+		free(g);
+	}
+	g_hash_table_destroy(table);
+
+	qsort(*groups, ngroups, sizeof(group_s), group_cmp_size);
+	return ngroups;
+}
+
+static int
+ids_cmp_size (const void *aa, const void *bb)
+{
+	TDU_SIZE_T a = node_table[*(const long *)aa]->size;
+	TDU_SIZE_T b = node_table[*(const long *)bb]->size;
+	return (a < b) - (a > b);
+}
+
+/* The ids of the files at or under root in key's group, largest first.
+   Returns how many; the caller frees *ids. */
+long
+group_members (node_s *root, const char *key, long **ids)
+{
+	long n, i, k;
+
+	n = slice_ids(root, group_is_file, ids);
+	for (i = k = 0; i < n; ++i)
+		if (!strcmp(extension(node_table[(*ids)[i]]->name), key))
+			(*ids)[k++] = (*ids)[i];
+	qsort(*ids, k, sizeof(long), ids_cmp_size);
+	return k;
+}
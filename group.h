@@ -0,0 +1,39 @@
+/*
+ * group.h
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#ifndef GROUP_H
+#define GROUP_H
+/*****************************************************************************/
+
+#include "tdu.h"
+#include "node.h"
+
+typedef struct group {
+	const char *key;	/* points into a node's name */
+	TDU_SIZE_T size;
+	long files;
+} group_s;
+
+long group_by_extension (node_s *root, group_s **groups);
+long group_members (node_s *root, const char *key, long **ids);
+
+/*****************************************************************************/
+#endif /* GROUP_H */
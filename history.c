@@ -0,0 +1,308 @@
+/*
+ * history.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "history.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <glib.h>
+
+/* Earlier du runs over the same tree, each dated, are read oldest first
+   and each node keeps only the changes in its size from one snapshot
+   to the next: a list of (snapshots since the last change, change in
+   size) pairs, as variable-length integers.  A node whose size never
+   changes costs one pair, and nodes are shared by all the snapshots.
+   The tree's own input is the last snapshot.
+
+   Paths that aren't in the tree are skipped, like the metrics'. */
+
+typedef struct snapshot {
+	char *pathname;		/* NULL for the tree's own input */
+	long day;		/* days since the epoch */
+} snapshot_s;
+
+typedef struct history {
+	unsigned char *bytes;
+	int len;
+	int alloc;
+} history_s;
+
+/* What history_load() keeps by id while it reads the snapshots. */
+typedef struct history_load {
+	TDU_SIZE_T *values;	/* sizes in the snapshot being read */
+	TDU_SIZE_T *last;	/* sizes as of the last change */
+	unsigned char *listed;	/* whether du listed the node */
+	int *last_snapshot;	/* the snapshot of the last change */
+} history_load_s;
+
+static snapshot_s *snapshots = NULL;
+int nsnapshots = 0;
+static history_s *histories = NULL; /* by id */
+static long nhistories = 0;
+int history_window = HISTORY_SHORT_WINDOW;
+
+/* The date of a snapshot: the first thing in its file name that looks
+   like YYYY-MM-DD or YYYYMMDD, or else when it was last modified.
+   Returns days since the epoch, or -1. */
+long
+history_file_day (const char *pathname)
+{
+	const char *name = strrchr(pathname, '/');
+	const char *p;
+	struct tm tm;
+	struct stat st;
+	int y, m, d;
+
+	for (p = name ? name + 1 : pathname; *p; ++p) {
+		if (!isdigit((unsigned char)*p)) continue;
+		if (sscanf(p, "%4d-%2d-%2d", &y, &m, &d) != 3
+		    && (strspn(p, "0123456789") < 8
+			|| sscanf(p, "%4d%2d%2d", &y, &m, &d) != 3))
+			continue;
+		if (y < 1970 || m < 1 || m > 12 || d < 1 || d > 31)
+			continue;
+		memset(&tm, 0, sizeof(tm));
+		tm.tm_year = y - 1900;
+		tm.tm_mon = m - 1;
+		tm.tm_mday = d;
+		tm.tm_hour = 12;
+		tm.tm_isdst = -1;
+		return mktime(&tm) / 86400;
+	}
+	if (stat(pathname, &st)) return -1;
+	return st.st_mtime / 86400;
+}
+
+/* Queue a snapshot to be read by history_load(). */
+void
+history_add (const char *pathname)
+{
+	snapshots = realloc(snapshots, (nsnapshots + 2) * sizeof(snapshot_s));
+	if (!snapshots || !(snapshots[nsnapshots].pathname = strdup(pathname))) {
+		perror("history_add: malloc");
+		exit(1);
+	}
+	snapshots[nsnapshots++].day = history_file_day(pathname);
+}
+
+static int
+snapshot_cmp (const void *aa, const void *bb)
+{
+	const snapshot_s *a = aa;
+	const snapshot_s *b = bb;
+	return (a->day > b->day) - (a->day < b->day);
+}
+
+static void
+history_put (history_s *h, unsigned long long v)
+{
+	if (h->len + VARINT_MAX > h->alloc) {
+		h->alloc = h->alloc ? h->alloc * 2 : 2 * VARINT_MAX;
+		h->bytes = realloc(h->bytes, h->alloc);
+		if (!h->bytes) {
+			perror("history_put: realloc");
+			exit(1);
+		}
+	}
+	h->len += varint_put(h->bytes + h->len, v);
+}
+
+/* Make room for every id in node_table, which grows as paths are
+   looked up in lazily read directories (see lazy.c). */
+static void
+history_grow (history_load_s *load)
+{
+	long n = node_table_size, id;
+
+	if (n <= nhistories) return;
+	histories = realloc(histories, n * sizeof(history_s));
+	load->values = realloc(load->values, n * sizeof(TDU_SIZE_T));
+	load->last = realloc(load->last, n * sizeof(TDU_SIZE_T));
+	load->listed = realloc(load->listed, n);
+	load->last_snapshot = realloc(load->last_snapshot, n * sizeof(int));
+	if (!histories || !load->values || !load->last || !load->listed
+	    || !load->last_snapshot) {
+		perror("history_grow: realloc");
+		exit(1);
+	}
+	for (id = nhistories; id < n; ++id) {
+		memset(&histories[id], 0, sizeof(history_s));
+		load->values[id] = 0;
+		load->last[id] = 0;
+		load->listed[id] = 0;
+		load->last_snapshot[id] = -1;
+	}
+	nhistories = n;
+}
+
+/* Fill in sizes du didn't list with their children's totals. */
+static TDU_SIZE_T
+fix_values (TDU_SIZE_T *values, const unsigned char *listed, node_s *node)
+{
+	TDU_SIZE_T total = 0;
+	long i;
+
+	for (i = 0; i < node->nchildren; ++i)
+		total += fix_values(values, listed, node->children[i]);
+	if (node->id < 0 || node->id >= nhistories)
+		return total;
+	if (!listed[node->id])
+		values[node->id] = total;
+	return values[node->id];
+}
+
+/* Read one snapshot's sizes into load->values (by id). */
+static int
+read_snapshot (node_s *root, const char *pathname, history_load_s *load)
+{
+	FILE *in;
+	char line[PATH_MAX+256];
+	char path[PATH_MAX];
+	TDU_SIZE_T size;
+
+	if (!(in = fopen(pathname, "r")))
+		return -1;
+	/* anything not in this snapshot was 0 */
+	memset(load->values, 0, nhistories * sizeof(TDU_SIZE_T));
+	memset(load->listed, 0, nhistories);
+	while (fgets(line, sizeof(line), in)) {
+		node_s *node = root;
+		char *p;
+
+		if (!parse_du_line(line, &size, path)) continue;
+		for (p = strtok(path, "/"); p && node; p = strtok(NULL, "/")) {
+			node_index_children(node);
+			node = g_hash_table_lookup(node->children_by_name, p);
+		}
+		history_grow(load);
+		if (node) {
+			load->values[node->id] = size;
+			load->listed[node->id] = 1;
+		}
+	}
+	fclose(in);
+	return 0;
+}
+
+/* Read the queued snapshots, oldest first, followed by the tree's own
+   sizes as of its input file current (NULL for stdin, meaning today).
+   Returns 0, or -1 with errno set and *failed pointing to the name of a
+   snapshot that can't be read. */
+int
+history_load (node_s *root, const char *current, const char **failed)
+{
+	history_load_s load = { NULL, NULL, NULL, NULL };
+	long id;
+	int i;
+
+	if (!nsnapshots) return 0;
+
+	snapshots[nsnapshots].pathname = NULL;
+	snapshots[nsnapshots].day = (current && strcmp(current, "-"))
+		? history_file_day(current) : (long)(time(NULL) / 86400);
+	++nsnapshots;
+	qsort(snapshots, nsnapshots, sizeof(snapshot_s), snapshot_cmp);
+
+	nhistories = 0;
+	history_grow(&load);
+
+	for (i = 0; i < nsnapshots; ++i) {
+		if (snapshots[i].pathname) {
+			if (read_snapshot(root, snapshots[i].pathname, &load)) {
+				*failed = snapshots[i].pathname;
+				return -1;
+			}
+			fix_values(load.values, load.listed, root);
+		}
+		else {
+			for (id = 0; id < nhistories; ++id)
+				load.values[id] = node_table[id]
+					? node_table[id]->size : 0;
+		}
+		for (id = 0; id < nhistories; ++id) {
+			long long delta = load.values[id] - load.last[id];
+			if (!delta && load.last_snapshot[id] >= 0) continue;
+			history_put(&histories[id], i - load.last_snapshot[id]);
+			history_put(&histories[id], ((unsigned long long)delta << 1)
+				   ^ (unsigned long long)(delta >> 63));
+			load.last[id] = load.values[id];
+			load.last_snapshot[id] = i;
+		}
+	}
+	cleanup_tree(root);
+	free(load.values);
+	free(load.last);
+	free(load.listed);
+	free(load.last_snapshot);
+	return 0;
+}
+
+/* A node's size as of a snapshot (0 being the oldest). */
+TDU_SIZE_T
+history_value (const node_s *node, int snapshot)
+{
+	const unsigned char *p, *end;
+	TDU_SIZE_T value = 0;
+	int i = -1;
+
+	if (node->id < 0 || node->id >= nhistories) return 0;
+	p = histories[node->id].bytes;
+	end = p + histories[node->id].len;
+	while (p < end) {
+		unsigned long long zz;
+		i += varint_get(&p);
+		zz = varint_get(&p);
+		if (i > snapshot) break;
+		value += (long long)(zz >> 1) ^ -(long long)(zz & 1);
+	}
+	return value;
+}
+
+/* How much a node has grown over the last days days: its size now less
+   its size in the latest snapshot at least that old (or the oldest). */
+long long
+history_growth (const node_s *node, int days)
+{
+	long since;
+	int i;
+
+	if (nsnapshots < 2) return 0;
+	since = snapshots[nsnapshots - 1].day - days;
+	for (i = nsnapshots - 1; i > 0 && snapshots[i].day > since; --i)
+		;
+	return (long long)history_value(node, nsnapshots - 1)
+		- (long long)history_value(node, i);
+}
+
+int
+node_cmp_growth (const node_s *a, const node_s *b)
+{
+	long long x = history_growth(a, history_window);
+	long long y = history_growth(b, history_window);
+	return (x > y) - (x < y);
+}
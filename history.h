@@ -0,0 +1,44 @@
+/*
+ * history.h
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+/*****************************************************************************/
+
+#include "tdu.h"
+#include "node.h"
+
+/* growth windows, in days, that can be shown and sorted by */
+#define HISTORY_SHORT_WINDOW 7
+#define HISTORY_LONG_WINDOW 30
+
+extern int nsnapshots;
+extern int history_window;
+
+long history_file_day (const char *pathname);
+void history_add (const char *pathname);
+int history_load (node_s *root, const char *current, const char **failed);
+TDU_SIZE_T history_value (const node_s *node, int snapshot);
+long long history_growth (const node_s *node, int days);
+int node_cmp_growth (const node_s *a, const node_s *b);
+
+/*****************************************************************************/
+#endif /* HISTORY_H */
@@ -0,0 +1,301 @@
+/*
+ * ingest.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "ingest.h"
+#include "scan.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+
+/* du's output arriving through a pipe is read in three stages, each in
+   its own thread, so that du never waits on the tree being built:
+
+	reader:     read()s into one buffer while the other is tokenized
+	tokenizer:  splits the buffers into lines, then into sizes and
+		    pathnames, a batch at a time
+	builder:    the caller, taking entries with ingest_next()
+
+   Buffers and batches go around in a loop: each stage passes full ones
+   to the next through a queue, and gets empty ones back through
+   another.  Each queue has exactly one thread putting things in and
+   one taking them out, so it needs no lock, only the two indexes
+   being read and written in the right order. */
+
+#define QUEUE_SIZE 8		/* more than any loop holds */
+#define READ_BUFFERS 2
+#define BATCHES 4
+#define BATCH_BYTES (64 * PATH_MAX)
+
+typedef struct queue {
+	void *items[QUEUE_SIZE];
+	unsigned long head;	/* next to take; written by the consumer */
+	unsigned long tail;	/* next to fill; written by the producer */
+} queue_s;
+
+typedef struct buffer {
+	char *data;
+	long len;		/* 0 at the end of the input */
+} buffer_s;
+
+typedef struct batch {
+	long n, next;
+	TDU_SIZE_T sizes[INGEST_BATCH_ENTRIES];
+	long paths[INGEST_BATCH_ENTRIES]; /* offsets into bytes */
+	long used;
+	bool last;		/* nothing follows */
+	char bytes[BATCH_BYTES];
+} batch_s;
+
+struct ingest {
+	int fd;
+	const char *head;	/* read already, to be passed on first */
+	long nhead;
+	pthread_t reader, tokenizer;
+	queue_s full_buffers, free_buffers;
+	queue_s full_batches, free_batches;
+	buffer_s buffers[READ_BUFFERS];
+	batch_s *batches[BATCHES];
+	batch_s *current;	/* the builder's */
+};
+
+/* Wait a little longer each time something isn't ready. */
+static void
+queue_wait (int *tries)
+{
+	struct timespec ts;
+
+	if (++*tries < 64) {
+		sched_yield();
+		return;
+	}
+	ts.tv_sec = 0;
+	ts.tv_nsec = (*tries < 256) ? 10000 : 1000000;
+	nanosleep(&ts, NULL);
+}
+
+static void
+queue_put (queue_s *q, void *item)
+{
+	unsigned long tail = q->tail;
+	int tries = 0;
+
+	while (tail - __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == QUEUE_SIZE)
+		queue_wait(&tries);
+	q->items[tail % QUEUE_SIZE] = item;
+	__atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static void *
+queue_take (queue_s *q)
+{
+	unsigned long head = q->head;
+	void *item;
+	int tries = 0;
+
+	while (__atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) == head)
+		queue_wait(&tries);
+	item = q->items[head % QUEUE_SIZE];
+	__atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+	return item;
+}
+
+static void *
+ingest_reader (void *data)
+{
+	ingest_s *ingest = data;
+	buffer_s *buffer;
+
+	do {
+		buffer = queue_take(&ingest->free_buffers);
+		if (ingest->nhead) {
+			memcpy(buffer->data, ingest->head, ingest->nhead);
+			buffer->len = ingest->nhead;
+			ingest->nhead = 0;
+			queue_put(&ingest->full_buffers, buffer);
+			continue;
+		}
+		do {
+			buffer->len = read(ingest->fd, buffer->data,
+					   INGEST_READ_SIZE);
+		} while (buffer->len < 0 && errno == EINTR);
+		if (buffer->len < 0) {
+			perror("ingest_reader: read");
+			buffer->len = 0;
+		}
+		queue_put(&ingest->full_buffers, buffer);
+	} while (buffer->len);
+	return NULL;
+}
+
+/* Add a line to a batch, passing the batch on and starting another
+   when it's full. */
+static batch_s *
+batch_add (ingest_s *ingest, batch_s *batch, const char *line,
+	   const char *end)
+{
+	if (!parse_du_span(line, end, &batch->sizes[batch->n],
+			   batch->bytes + batch->used))
+		return batch;
+	batch->paths[batch->n++] = batch->used;
+	batch->used += strlen(batch->bytes + batch->used) + 1;
+	if (batch->n == INGEST_BATCH_ENTRIES
+	    || BATCH_BYTES - batch->used < PATH_MAX) {
+		queue_put(&ingest->full_batches, batch);
+		batch = queue_take(&ingest->free_batches);
+		batch->n = batch->next = batch->used = 0;
+		batch->last = 0;
+	}
+	return batch;
+}
+
+static void *
+ingest_tokenizer (void *data)
+{
+	ingest_s *ingest = data;
+	buffer_s *buffer;
+	batch_s *batch;
+	char carry[PATH_MAX+256];	/* a line split between buffers */
+	long ncarry = 0;
+	bool too_long = 0;
+
+	batch = queue_take(&ingest->free_batches);
+	batch->n = batch->next = batch->used = 0;
+	batch->last = 0;
+	while ((buffer = queue_take(&ingest->full_buffers))->len) {
+		const char *p = buffer->data, *end = p + buffer->len;
+
+		while (p < end) {
+			const char *nl = scan_char(p, end, '\n');
+			if (nl == end) {
+				/* keep the start of the line for later */
+				if (ncarry + (end - p) > sizeof(carry))
+					too_long = 1;
+				else {
+					memcpy(carry + ncarry, p, end - p);
+					ncarry += end - p;
+				}
+				break;
+			}
+			if (ncarry || too_long) {
+				if (!too_long
+				    && ncarry + (nl - p) <= sizeof(carry)) {
+					memcpy(carry + ncarry, p, nl - p);
+					batch = batch_add(ingest, batch, carry,
+							  carry + ncarry + (nl - p));
+				}
+				ncarry = 0;
+				too_long = 0;
+			}
+			else {
+				batch = batch_add(ingest, batch, p, nl);
+			}
+			p = nl + 1;
+		}
+		queue_put(&ingest->free_buffers, buffer);
+	}
+	if (ncarry && !too_long)
+		batch = batch_add(ingest, batch, carry, carry + ncarry);
+	batch->last = 1;
+	queue_put(&ingest->full_batches, batch);
+	return NULL;
+}
+
+/* Start reading du output from fd, after the nhead bytes at head
+   (at most INGEST_READ_SIZE) that have been read from it already. */
+ingest_s *
+ingest_start (int fd, const char *head, long nhead)
+{
+	ingest_s *ingest = calloc(1, sizeof(ingest_s));
+	int i;
+
+	if (!ingest) {
+		perror("ingest_start: calloc");
+		exit(1);
+	}
+	ingest->fd = fd;
+	ingest->head = head;
+	ingest->nhead = nhead;
+	for (i = 0; i < READ_BUFFERS; ++i) {
+		if (!(ingest->buffers[i].data = malloc(INGEST_READ_SIZE))) {
+			perror("ingest_start: malloc");
+			exit(1);
+		}
+		queue_put(&ingest->free_buffers, &ingest->buffers[i]);
+	}
+	for (i = 0; i < BATCHES; ++i) {
+		if (!(ingest->batches[i] = malloc(sizeof(batch_s)))) {
+			perror("ingest_start: malloc");
+			exit(1);
+		}
+		queue_put(&ingest->free_batches, ingest->batches[i]);
+	}
+	if (pthread_create(&ingest->reader, NULL, ingest_reader, ingest)
+	    || pthread_create(&ingest->tokenizer, NULL, ingest_tokenizer,
+			      ingest)) {
+		perror("ingest_start: pthread_create");
+		exit(1);
+	}
+	return ingest;
+}
+
+/* Take the next entry, in the order du listed them.  The pathname stays
+   valid until the next call.  Returns 0 at the end of the input. */
+bool
+ingest_next (ingest_s *ingest, TDU_SIZE_T *size, const char **path)
+{
+	batch_s *batch = ingest->current;
+
+	while (!batch || batch->next == batch->n) {
+		if (batch) {
+			if (batch->last) return 0;
+			queue_put(&ingest->free_batches, batch);
+		}
+		batch = ingest->current = queue_take(&ingest->full_batches);
+	}
+	*size = batch->sizes[batch->next];
+	*path = batch->bytes + batch->paths[batch->next];
+	++batch->next;
+	return 1;
+}
+
+/* Once ingest_next() has returned 0, wait for the other stages to
+   finish and free everything. */
+void
+ingest_finish (ingest_s *ingest)
+{
+	int i;
+
+	pthread_join(ingest->reader, NULL);
+	pthread_join(ingest->tokenizer, NULL);
+	for (i = 0; i < READ_BUFFERS; ++i)
+		free(ingest->buffers[i].data);
+	for (i = 0; i < BATCHES; ++i)
+		free(ingest->batches[i]);
+	free(ingest);
+}
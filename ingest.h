@@ -0,0 +1,41 @@
+/*
+ * ingest.h
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#ifndef INGEST_H
+#define INGEST_H
+/*****************************************************************************/
+
+#include "tdu.h"
+#include "node.h"
+
+/* bytes per read() */
+#define INGEST_READ_SIZE (1 << 20)
+/* entries passed from the tokenizer to the tree builder at a time */
+#define INGEST_BATCH_ENTRIES 4096
+
+typedef struct ingest ingest_s;
+
+ingest_s *ingest_start (int fd, const char *head, long nhead);
+bool ingest_next (ingest_s *ingest, TDU_SIZE_T *size, const char **path);
+void ingest_finish (ingest_s *ingest);
+
+/*****************************************************************************/
+#endif /* INGEST_H */
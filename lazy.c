@@ -0,0 +1,220 @@
+/*
+ * lazy.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "lazy.h"
+#include "scan.h"
+#include "search.h"
+#include "sizeindex.h"
+#include "filter.h"
+#include "ncdu.h"
+#include "sketch.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <glib.h>
+
+/* du lists everything in a directory on the lines just before the
+   directory's own line.  So the tree can be built only a few levels
+   deep at first: the first pass over the file creates nodes for
+   pathnames down to a given depth, and for each directory at that
+   depth notes where the lines for what's in it start and end.  The
+   directory gets its size from its own line and, until it's read, the
+   number of those lines as its number of descendents.  Expanding it
+   reads its lines and builds the same number of levels below it.
+
+   Lines for things below that depth whose directory is never listed
+   themselves are added as they would have been without all this. */
+
+typedef struct lazy_range {
+	off_t start, end;	/* byte offsets of the lines in the file */
+	int prefix_len;		/* length of the directory's pathname */
+} lazy_range_s;
+
+static FILE *lazy_file = NULL;
+int lazy_depth = 0;
+static GHashTable *lazy_ranges = NULL; /* id -> lazy_range_s */
+
+/* How many names a pathname has, the way add_node() splits it. */
+static int
+path_depth (const char *path)
+{
+	const char *end = path + strlen(path);
+	const char *slash;
+	int depth = 0;
+
+	for (; path < end; path = slash + 1) {
+		slash = scan_char(path, end, '/');
+		if (slash > path) ++depth;
+	}
+	return depth;
+}
+
+/* Add every line between two offsets to the tree under base. */
+static void
+lazy_add_all (node_s *base, int prefix_len, off_t start, off_t end)
+{
+	char line[PATH_MAX+256];
+	char path[PATH_MAX];
+	TDU_SIZE_T size;
+	off_t offset = start;
+
+	if (fseeko(lazy_file, start, SEEK_SET)) return;
+	while (offset < end && fgets(line, sizeof(line), lazy_file)) {
+		offset += strlen(line);
+		if (!parse_du_line(line, &size, path)) continue;
+		if (strlen(path) > prefix_len)
+			add_node(base, path + prefix_len, size);
+	}
+}
+
+/* Build the tree under base from the lines between two offsets, down to
+   depth levels below it, noting the ranges of lines for directories at
+   that depth. */
+static void
+lazy_scan (node_s *base, int prefix_len, off_t start, off_t end, int depth)
+{
+	char line[PATH_MAX+256];
+	char path[PATH_MAX];
+	TDU_SIZE_T size;
+	off_t offset = start, run_start = start;
+	long deeper = 0;
+
+	if (fseeko(lazy_file, start, SEEK_SET)) return;
+	while (offset < end && fgets(line, sizeof(line), lazy_file)) {
+		off_t line_start = offset;
+		node_s *node;
+		int d;
+
+		offset += strlen(line);
+		if (!parse_du_line(line, &size, path)
+		    || strlen(path) <= prefix_len)
+			continue;
+		d = path_depth(path + prefix_len);
+		if (d > depth) {
+			++deeper;
+			continue;
+		}
+		node = add_node(base, path + prefix_len, size);
+		if (deeper && d == depth && !node->nchildren) {
+			lazy_range_s *r = malloc(sizeof(lazy_range_s));
+			if (!r) {
+				perror("lazy_scan: malloc");
+				exit(1);
+			}
+			r->start = run_start;
+			r->end = line_start;
+			r->prefix_len = strlen(path);
+			node->descendents = deeper;
+			g_hash_table_insert(lazy_ranges, (gpointer)node->id, r);
+		}
+		else if (deeper) {
+			lazy_add_all(base, prefix_len, run_start, line_start);
+			fseeko(lazy_file, offset, SEEK_SET);
+		}
+		deeper = 0;
+		run_start = offset;
+	}
+	if (deeper)
+		lazy_add_all(base, prefix_len, run_start, offset);
+}
+
+/* Read du output from a regular file, building depth levels of the tree
+   and leaving the rest to be read when it's expanded.  An ncdu export
+   is read in full.  Returns NULL, having said why, if the file can't be
+   read. */
+node_s *
+lazy_parse_file (const char *pathname, int depth)
+{
+	node_s *node;
+	struct stat st;
+	char head[4096];
+	long nhead;
+
+	if (!(lazy_file = fopen(pathname, "r"))) {
+		fprintf(stderr, "Cannot open %s: %s\n",
+			pathname, strerror(errno));
+		return NULL;
+	}
+	if (fstat(fileno(lazy_file), &st) || !S_ISREG(st.st_mode)) {
+		fprintf(stderr, "%s: not a regular file\n", pathname);
+		return NULL;
+	}
+	nhead = pread(fileno(lazy_file), head, sizeof(head), 0);
+	if (nhead > 0 && ncdu_detect(head, head + nhead)) {
+		fclose(lazy_file);
+		lazy_file = NULL;
+		return parse_file(pathname);
+	}
+	lazy_depth = depth;
+	lazy_ranges = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	node = new_node(NULL);
+	node->name = "[root]";	/* no strdup necessary or wanted */
+	lazy_scan(node, 0, 0, st.st_size, depth);
+
+	fix_tree_sizes(node);
+	fix_tree_descendents(node);
+	cleanup_tree(node);
+	return node;
+}
+
+bool
+lazy_is_lazy (const node_s *node)
+{
+	return (lazy_ranges && node && !node->nchildren && node->id >= 0
+		&& node->id < node_table_size && node_table[node->id] == node
+		&& g_hash_table_lookup(lazy_ranges, (gpointer)node->id));
+}
+
+/* Read the lines for what's in a directory not read yet. */
+void
+lazy_load (node_s *node)
+{
+	lazy_range_s *r;
+	long descendents;
+	node_s *p;
+
+	if (!lazy_is_lazy(node)) return;
+	search_index_invalidate();
+	size_index_invalidate();
+	filter_reset();
+
+	r = g_hash_table_lookup(lazy_ranges, (gpointer)node->id);
+	g_hash_table_remove(lazy_ranges, (gpointer)node->id);
+	lazy_scan(node, r->prefix_len, r->start, r->end, lazy_depth);
+	free(r);
+
+	fix_tree_sizes(node);
+	descendents = node->descendents;
+	node->descendents = -1;
+	fix_tree_descendents(node);
+	for (p = node->parent; p; p = p->parent)
+		p->descendents += node->descendents - descendents;
+	sketch_merge_up(node->parent);
+	cleanup_tree(node);
+}
@@ -0,0 +1,37 @@
+/*
+ * lazy.h
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#ifndef LAZY_H
+#define LAZY_H
+/*****************************************************************************/
+
+#include "tdu.h"
+#include "node.h"
+
+/* levels read at a time, or 0 if the whole tree was read at once */
+extern int lazy_depth;
+
+node_s *lazy_parse_file (const char *pathname, int depth);
+bool lazy_is_lazy (const node_s *node);
+void lazy_load (node_s *node);
+
+/*****************************************************************************/
+#endif /* LAZY_H */
@@ -0,0 +1,161 @@
+/*
+ * metric.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "metric.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <glib.h>
+
+metric_s metrics[METRIC_MAX];
+int nmetrics = 0;
+int metric_sort_column = 0;	/* which metric node_cmp_metric() uses */
+
+TDU_SIZE_T
+metric_value (int m, const node_s *node)
+{
+	if (m < 0 || m >= nmetrics || node->id < 0
+	    || node->id >= metrics[m].n)
+		return 0;
+	return metrics[m].values[node->id];
+}
+
+/* Fill in the values du didn't list with the totals of their
+   children's, as fix_tree_sizes() does for sizes. */
+static TDU_SIZE_T
+metric_fix (TDU_SIZE_T *values, long n, node_s *node)
+{
+	TDU_SIZE_T total = 0;
+	long i;
+
+	for (i = 0; i < node->nchildren; ++i)
+		total += metric_fix(values, n, node->children[i]);
+	if (node->id < 0 || node->id >= n)
+		return total;
+	if (values[node->id] == METRIC_UNSET)
+		values[node->id] = total;
+	return values[node->id];
+}
+
+/* Make room in values, n of them, for every id in node_table, which
+   grows as paths are looked up in lazily read directories (see
+   lazy.c).  The new ones are METRIC_UNSET. */
+static TDU_SIZE_T *
+metric_grow (TDU_SIZE_T *values, long *n)
+{
+	long i;
+
+	if (node_table_size <= *n) return values;
+	values = realloc(values, node_table_size * sizeof(TDU_SIZE_T));
+	if (!values) {
+		perror("metric_grow: realloc");
+		exit(1);
+	}
+	for (i = *n; i < node_table_size; ++i)
+		values[i] = METRIC_UNSET;
+	*n = node_table_size;
+	return values;
+}
+
+/* Read du output from pathname as a metric called name.  Paths that
+   aren't in the tree are skipped.  Returns 0, or -1 with errno set if
+   the file can't be read. */
+int
+metric_load (node_s *root, const char *name, const char *pathname)
+{
+	FILE *in;
+	char line[PATH_MAX+256];
+	char path[PATH_MAX];
+	TDU_SIZE_T size, *values;
+	long n, missing = 0;
+
+	if (nmetrics == METRIC_MAX) {
+		errno = ENOSPC;
+		return -1;
+	}
+	if (!pathname || !strcmp(pathname, "-")) {
+		in = stdin;
+	}
+	else if (!(in = fopen(pathname, "r"))) {
+		return -1;
+	}
+
+	n = 0;
+	values = metric_grow(NULL, &n);
+
+	while (fgets(line, sizeof(line), in)) {
+		node_s *node = root;
+		char *p;
+
+		if (!parse_du_line(line, &size, path)) continue;
+		for (p = strtok(path, "/"); p && node; p = strtok(NULL, "/")) {
+			node_index_children(node);
+			node = g_hash_table_lookup(node->children_by_name, p);
+		}
+		values = metric_grow(values, &n);
+		if (node)
+			values[node->id] = size;
+		else
+			++missing;
+	}
+	if (in != stdin) fclose(in);
+	cleanup_tree(root);
+
+	if (missing)
+		fprintf(stderr, "%s: %ld paths not in the tree\n",
+			pathname, missing);
+	return metric_add(root, name, values, n);
+}
+
+/* Add a metric called name whose values by id, n of them, have been
+   gathered some other way.  Values left METRIC_UNSET are filled in with
+   the totals of their children's.  The metric takes over values.
+   Returns 0, or -1 with errno set if there are too many metrics. */
+int
+metric_add (node_s *root, const char *name, TDU_SIZE_T *values, long n)
+{
+	if (nmetrics == METRIC_MAX) {
+		free(values);
+		errno = ENOSPC;
+		return -1;
+	}
+	metric_fix(values, n, root);
+	if (!(metrics[nmetrics].name = strdup(name))) {
+		perror("metric_add: strdup");
+		exit(1);
+	}
+	metrics[nmetrics].values = values;
+	metrics[nmetrics].n = n;
+	++nmetrics;
+	return 0;
+}
+
+int
+node_cmp_metric (const node_s *a, const node_s *b)
+{
+	TDU_SIZE_T x = metric_value(metric_sort_column, a);
+	TDU_SIZE_T y = metric_value(metric_sort_column, b);
+	return (x > y) - (x < y);
+}
@@ -0,0 +1,55 @@
+/*
+ * metric.h
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#ifndef METRIC_H
+#define METRIC_H
+/*****************************************************************************/
+
+#include "tdu.h"
+#include "node.h"
+
+#define METRIC_MAX 8
+
+/* a value not known yet, to be filled in from the children's */
+#define METRIC_UNSET ((TDU_SIZE_T)-1)
+
+/* A metric is another du run over the same tree (apparent sizes,
+   inode counts, ...), kept as one array of values indexed by node id
+   rather than as fields in the nodes, so that adding a metric doesn't
+   grow every node and a pass over one metric touches only its own
+   array. */
+typedef struct metric {
+	char *name;
+	TDU_SIZE_T *values;	/* by id */
+	long n;			/* ids covered; later nodes count as 0 */
+} metric_s;
+
+extern metric_s metrics[METRIC_MAX];
+extern int nmetrics;
+extern int metric_sort_column;
+
+TDU_SIZE_T metric_value (int m, const node_s *node);
+int metric_load (node_s *root, const char *name, const char *pathname);
+int metric_add (node_s *root, const char *name, TDU_SIZE_T *values, long n);
+int node_cmp_metric (const node_s *a, const node_s *b);
+
+/*****************************************************************************/
+#endif /* METRIC_H */
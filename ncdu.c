@@ -0,0 +1,498 @@
+/*
+ * ncdu.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "metric.h"
+#include "spill.h"
+#include "ncdu.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <glib.h>
+
+/* ncdu -o exports a directory tree as nested JSON arrays:
+
+	[1, 2, {"progname": "ncdu", ...},
+	 [{"name": "/home/dse", "asize": 4096, "dsize": 4096, ...},
+	  {"name": ".bashrc", "asize": 3526, "dsize": 4096},
+	  [{"name": "src", ...}, ...contents of src...],
+	  ...]]
+
+   A directory is an array of its own entry followed by what's in it;
+   anything else is just an entry.  The export is read a character at a
+   time, and each entry becomes a node as soon as it has been read, so
+   that nothing is kept besides the tree and the names of the
+   directories still open.
+
+   Sizes are taken from dsize, the disk usage du would show, and a hard
+   link is counted only the first time it is seen, as du does.  The
+   apparent sizes are kept as a metric column, "apparent". */
+
+#define NCDU_READ_SIZE (1 << 20)
+
+typedef struct ncdu_input {
+	const char *p, *end;
+	int fd;			/* to read more from, or -1 */
+	char *buf;
+	long long offset;	/* of end in the input */
+} ncdu_input_s;
+
+typedef struct ncdu_entry {
+	char name[PATH_MAX];
+	TDU_SIZE_T asize, dsize;
+	TDU_SIZE_T dev, ino, nlink;
+	bool hardlink;
+	bool excluded;
+} ncdu_entry_s;
+
+typedef struct ncdu {
+	ncdu_input_s in;
+	node_s *root;
+	TDU_SIZE_T *apparent;	/* by id */
+	long napparent;
+	GHashTable *inodes;	/* hard links counted already */
+	ncdu_entry_s entry;	/* the last one read */
+	long entries;
+	int show_progress;
+} ncdu_s;
+
+static int
+ncdu_fill (ncdu_input_s *in)
+{
+	long len;
+
+	if (in->fd < 0) return EOF;
+	if (!in->buf && !(in->buf = malloc(NCDU_READ_SIZE))) {
+		perror("ncdu_fill: malloc");
+		exit(1);
+	}
+	do {
+		len = read(in->fd, in->buf, NCDU_READ_SIZE);
+	} while (len < 0 && errno == EINTR);
+	if (len <= 0) {
+		if (len < 0) perror("ncdu_fill: read");
+		in->fd = -1;
+		return EOF;
+	}
+	in->p = in->buf;
+	in->end = in->buf + len;
+	in->offset += len;
+	return (unsigned char) *in->p++;
+}
+
+#define NCDU_GETC(in) \
+	((in)->p < (in)->end ? (unsigned char) *(in)->p++ : ncdu_fill(in))
+
+static bool
+ncdu_is_space (int c)
+{
+	return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+/* the next character that isn't white space */
+static int
+ncdu_token (ncdu_input_s *in)
+{
+	int c;
+
+	do {
+		c = NCDU_GETC(in);
+	} while (ncdu_is_space(c));
+	return c;
+}
+
+/* Append a character to buf as UTF-8. */
+static int
+ncdu_utf8 (char *buf, long code)
+{
+	if (code < 0x80) {
+		buf[0] = code;
+		return 1;
+	}
+	if (code < 0x800) {
+		buf[0] = 0xc0 | (code >> 6);
+		buf[1] = 0x80 | (code & 0x3f);
+		return 2;
+	}
+	if (code < 0x10000) {
+		buf[0] = 0xe0 | (code >> 12);
+		buf[1] = 0x80 | ((code >> 6) & 0x3f);
+		buf[2] = 0x80 | (code & 0x3f);
+		return 3;
+	}
+	buf[0] = 0xf0 | (code >> 18);
+	buf[1] = 0x80 | ((code >> 12) & 0x3f);
+	buf[2] = 0x80 | ((code >> 6) & 0x3f);
+	buf[3] = 0x80 | (code & 0x3f);
+	return 4;
+}
+
+/* the four hex digits of a \u escape, or -1 */
+static long
+ncdu_hex4 (ncdu_input_s *in)
+{
+	long code = 0;
+	int i, c;
+
+	for (i = 0; i < 4; ++i) {
+		c = NCDU_GETC(in);
+		if (c >= '0' && c <= '9') code = code * 16 + c - '0';
+		else if (c >= 'a' && c <= 'f') code = code * 16 + c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F') code = code * 16 + c - 'A' + 10;
+		else return -1;
+	}
+	return code;
+}
+
+/* Read the rest of a string whose opening quote has been read into buf,
+   as much of it as fits.  Returns its whole length, or -1 if it isn't
+   a string. */
+static long
+ncdu_string (ncdu_input_s *in, char *buf, long size)
+{
+	char utf8[4];
+	long len = 0, code, low;
+	int c, n, i;
+
+	for (;;) {
+		c = NCDU_GETC(in);
+		if (c == '"') break;
+		if (c == EOF) return -1;
+		n = 1;
+		utf8[0] = c;
+		if (c == '\\') {
+			switch (c = NCDU_GETC(in)) {
+			case 'b': utf8[0] = '\b'; break;
+			case 'f': utf8[0] = '\f'; break;
+			case 'n': utf8[0] = '\n'; break;
+			case 'r': utf8[0] = '\r'; break;
+			case 't': utf8[0] = '\t'; break;
+			case '"': case '\\': case '/': utf8[0] = c; break;
+			case 'u':
+				if ((code = ncdu_hex4(in)) < 0) return -1;
+				/* a character outside the BMP comes as a
+				   surrogate pair */
+				if (code >= 0xd800 && code < 0xdc00) {
+					if (NCDU_GETC(in) != '\\'
+					    || NCDU_GETC(in) != 'u'
+					    || (low = ncdu_hex4(in)) < 0xdc00
+					    || low >= 0xe000)
+						return -1;
+					code = 0x10000 + ((code - 0xd800) << 10)
+						+ (low - 0xdc00);
+				}
+				n = ncdu_utf8(utf8, code);
+				break;
+			default:
+				return -1;
+			}
+		}
+		for (i = 0; i < n; ++i, ++len)
+			if (len < size - 1) buf[len] = utf8[i];
+	}
+	buf[len < size ? len : size - 1] = '\0';
+	return len;
+}
+
+/* Read a number starting with c, a digit.  Returns the next token. */
+static int
+ncdu_number (ncdu_input_s *in, int c, TDU_SIZE_T *value)
+{
+	*value = 0;
+	if (c < '0' || c > '9') return EOF;
+	for (; c >= '0' && c <= '9'; c = NCDU_GETC(in))
+		*value = *value * 10 + (c - '0');
+	/* a fraction or exponent isn't expected, and is ignored */
+	while (c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-'
+	       || (c >= '0' && c <= '9'))
+		c = NCDU_GETC(in);
+	return ncdu_is_space(c) ? ncdu_token(in) : c;
+}
+
+/* Skip a value starting with c.  Returns the next token. */
+static int
+ncdu_skip (ncdu_input_s *in, int c)
+{
+	char scratch[1];
+	int depth = 0;
+
+	for (;;) {
+		if (c == '"') {
+			if (ncdu_string(in, scratch, sizeof(scratch)) < 0)
+				return EOF;
+		}
+		else if (c == '[' || c == '{') {
+			++depth;
+		}
+		else if (c == ']' || c == '}') {
+			--depth;
+		}
+		else if (c == EOF) {
+			return EOF;
+		}
+		else if (!depth) {
+			/* a number, true, false or null */
+			while (c != EOF && (c == '.' || c == '+' || c == '-'
+					    || (c >= '0' && c <= '9')
+					    || (c >= 'a' && c <= 'z')
+					    || (c >= 'A' && c <= 'Z')))
+				c = NCDU_GETC(in);
+			return ncdu_is_space(c) ? ncdu_token(in) : c;
+		}
+		if (!depth) return ncdu_token(in);
+		c = NCDU_GETC(in);
+	}
+}
+
+/* Read an entry whose opening brace has been read.  Returns 0 if it
+   isn't one. */
+static bool
+ncdu_entry (ncdu_input_s *in, ncdu_entry_s *e)
+{
+	char key[16];
+	TDU_SIZE_T value;
+	int c;
+
+	e->name[0] = '\0';
+	e->asize = e->dsize = e->dev = e->ino = e->nlink = 0;
+	e->hardlink = e->excluded = 0;
+
+	if ((c = ncdu_token(in)) == '}') return 1;
+	for (;;) {
+		if (c != '"' || ncdu_string(in, key, sizeof(key)) < 0
+		    || ncdu_token(in) != ':')
+			return 0;
+		c = ncdu_token(in);
+		if (!strcmp(key, "name")) {
+			if (c != '"' || ncdu_string(in, e->name,
+						    sizeof(e->name))
+			    >= sizeof(e->name))
+				return 0;
+			c = ncdu_token(in);
+		}
+		else if (c >= '0' && c <= '9') {
+			c = ncdu_number(in, c, &value);
+			if (!strcmp(key, "asize")) e->asize = value;
+			else if (!strcmp(key, "dsize")) e->dsize = value;
+			else if (!strcmp(key, "dev")) e->dev = value;
+			else if (!strcmp(key, "ino")) e->ino = value;
+			else if (!strcmp(key, "nlink")) e->nlink = value;
+		}
+		else {
+			if (!strcmp(key, "hlnkc")) e->hardlink = (c == 't');
+			if (!strcmp(key, "excluded")) e->excluded = 1;
+			c = ncdu_skip(in, c);
+		}
+		if (c == '}') break;
+		if (c != ',') return 0;
+		c = ncdu_token(in);
+	}
+	if (e->nlink > 1) e->hardlink = 1;
+	return e->name[0] != '\0';
+}
+
+/* Set a node's apparent size. */
+static void
+ncdu_apparent (ncdu_s *ncdu, node_s *node, TDU_SIZE_T asize)
+{
+	long n = ncdu->napparent;
+
+	if (node->id >= n) {
+		ncdu->napparent = (node->id + 1) * 2;
+		ncdu->apparent = realloc(ncdu->apparent, ncdu->napparent
+					 * sizeof(TDU_SIZE_T));
+		if (!ncdu->apparent) {
+			perror("ncdu_apparent: realloc");
+			exit(1);
+		}
+		for (; n < ncdu->napparent; ++n)
+			ncdu->apparent[n] = METRIC_UNSET;
+	}
+	ncdu->apparent[node->id] = asize;
+}
+
+/* Add what an entry takes up to a directory's totals, unless it's a
+   hard link that has been counted already. */
+static void
+ncdu_count (ncdu_s *ncdu, const ncdu_entry_s *e, TDU_SIZE_T *dsize,
+	    TDU_SIZE_T *asize)
+{
+	gpointer key = (gpointer)(long)(e->ino ^ (e->dev << 40));
+
+	if (e->hardlink && e->ino) {
+		if (g_hash_table_lookup(ncdu->inodes, key)) return;
+		g_hash_table_insert(ncdu->inodes, key, key);
+	}
+	*dsize += e->dsize;
+	*asize += e->asize;
+}
+
+static TDU_SIZE_T
+ncdu_blocks (TDU_SIZE_T bytes)
+{
+	return (bytes + tdu_block_size - 1) / tdu_block_size;
+}
+
+static void
+ncdu_added (ncdu_s *ncdu)
+{
+	++ncdu->entries;
+	if (ncdu->show_progress && !(ncdu->entries % 100))
+		fprintf(stderr, "  %ld entries\r", ncdu->entries);
+}
+
+/* Read a directory whose opening bracket has been read, adding it
+   under parent (or, for the top one, at the pathname it names), and
+   add what it takes up to *dsize and *asize.  If parent is NULL, the
+   directory is read but left out.  Returns 0 if it isn't one. */
+static bool
+ncdu_dir (ncdu_s *ncdu, node_s *parent, TDU_SIZE_T *dsize,
+	  TDU_SIZE_T *asize)
+{
+	ncdu_input_s *in = &ncdu->in;
+	ncdu_entry_s *e = &ncdu->entry;	/* not needed after recursing */
+	TDU_SIZE_T total = 0, atotal = 0, d, a;
+	node_s *node = NULL, *child;
+	int c;
+
+	if (ncdu_token(in) != '{' || !ncdu_entry(in, e))
+		return 0;
+	if (parent && !e->excluded) {
+		if (parent == ncdu->root) {
+			node = add_node(parent, e->name, 0);
+			node->size = -1;	/* unless it's read in full */
+		}
+		else {
+			node = new_node(e->name);
+			add_child(parent, node);
+		}
+		ncdu_count(ncdu, e, &total, &atotal);
+	}
+
+	while ((c = ncdu_token(in)) != ']') {
+		if (c != ',') return 0;
+		c = ncdu_token(in);
+		if (c == '[') {
+			d = a = 0;
+			if (!ncdu_dir(ncdu, node, &d, &a)) return 0;
+			total += d;
+			atotal += a;
+		}
+		else if (c == '{') {
+			if (!ncdu_entry(in, e)) return 0;
+			if (!node || e->excluded) continue;
+			d = a = 0;
+			ncdu_count(ncdu, e, &d, &a);
+			child = new_node(e->name);
+			add_child(node, child);
+			child->size = ncdu_blocks(d);
+			ncdu_apparent(ncdu, child, a);
+			ncdu_added(ncdu);
+			total += d;
+			atotal += a;
+		}
+		else {
+			return 0;
+		}
+	}
+	if (!node) return 1;
+
+	node->size = ncdu_blocks(total);
+	ncdu_apparent(ncdu, node, atotal);
+	if (node->children_by_name) {
+		g_hash_table_destroy(node->children_by_name);
+		node->children_by_name = NULL;
+	}
+	if (tdu_memory_limit && node_memory > tdu_memory_limit)
+		spill_node(node);
+	ncdu_added(ncdu);
+	*dsize += total;
+	*asize += atotal;
+	return 1;
+}
+
+/* Is the input starting at p an ncdu export rather than du output? */
+bool
+ncdu_detect (const char *p, const char *end)
+{
+	while (p < end && ncdu_is_space(*p)) ++p;
+	return p < end && *p == '[';
+}
+
+/* Read an ncdu export into the tree under root: the len bytes at data,
+   followed by whatever can be read from fd, if it isn't -1.  pathname
+   is only for messages.  Returns the number of entries read. */
+long
+ncdu_parse (node_s *root, const char *pathname, int fd, const char *data,
+	    long len, int show_progress)
+{
+	ncdu_s ncdu;
+	ncdu_input_s *in = &ncdu.in;
+	TDU_SIZE_T version, minor, d = 0, a = 0;
+	bool ok;
+	long n;
+
+	in->p = data;
+	in->end = data + len;
+	in->fd = fd;
+	in->buf = NULL;
+	in->offset = len;
+	ncdu.root = root;
+	ncdu.apparent = NULL;
+	ncdu.napparent = 0;
+	ncdu.inodes = g_hash_table_new(g_direct_hash, g_direct_equal);
+	ncdu.entries = 0;
+	ncdu.show_progress = show_progress;
+
+	ok = (ncdu_token(in) == '['
+	      && ncdu_number(in, ncdu_token(in), &version) == ','
+	      && version == 1
+	      && ncdu_number(in, ncdu_token(in), &minor) == ','
+	      && ncdu_token(in) == '{'
+	      && ncdu_skip(in, '{') == ','
+	      && ncdu_token(in) == '['
+	      && ncdu_dir(&ncdu, root, &d, &a)
+	      && ncdu_token(in) == ']');
+	if (!ok)
+		fprintf(stderr, "%s: not an ncdu export, or cut short, "
+			"at byte %lld\n", pathname ? pathname : "stdin",
+			in->offset - (in->end - in->p));
+
+	/* the apparent sizes of the directories leading to the top one
+	   are filled in by metric_add() */
+	n = node_table_size;
+	ncdu.apparent = realloc(ncdu.apparent, n * sizeof(TDU_SIZE_T));
+	if (!ncdu.apparent) {
+		perror("ncdu_parse: realloc");
+		exit(1);
+	}
+	for (; ncdu.napparent < n; ++ncdu.napparent)
+		ncdu.apparent[ncdu.napparent] = METRIC_UNSET;
+	metric_add(root, "apparent", ncdu.apparent, n);
+
+	g_hash_table_destroy(ncdu.inodes);
+	free(in->buf);
+	return ncdu.entries;
+}
@@ -0,0 +1,34 @@
+/*
+ * ncdu.h
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#ifndef NCDU_H
+#define NCDU_H
+/*****************************************************************************/
+
+#include "tdu.h"
+#include "node.h"
+
+bool ncdu_detect (const char *p, const char *end);
+long ncdu_parse (node_s *root, const char *pathname, int fd,
+		 const char *data, long len, int show_progress);
+
+/*****************************************************************************/
+#endif /* NCDU_H */
@@ -21,18 +21,44 @@
 
 #include "tdu.h"
 #include "node.h"
+#include "spill.h"
+#include "lazy.h"
+#include "scan.h"
+#include "ingest.h"
+#include "ncdu.h"
+#include "bfs.h"
+#include "perf.h"
+#include "sketch.h"
 #include <errno.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <limits.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <curses.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <glib.h>
 
-/* Create a new node, initialize its contents, and return a pointer to it. */
-node_s *
-new_node (const char *name)	/* if not NULL, initialize node's name */
+long tdu_block_size = 1024;	/* bytes per unit of size in the input */
+long tdu_rollup = 1000;		/* show this many children at a time */
+bool tdu_fold = 0;		/* fold chains again after updates */
+bool tdu_natural_sort = 0;	/* numbers in names in order of value */
+bool tdu_absolute_paths = 0;	/* the input's pathnames start with / */
+
+node_s **node_table = NULL;
+long node_table_size = 0;
+static long node_table_alloc = 0;
+
+/* Roughly how much memory the nodes in node_table take up. */
+long node_memory = 0;
+
+/* Create a new node and initialize its contents, without giving it an
+   id. */
+static node_s *
+alloc_node (const char *name)	/* if not NULL, initialize node's name */
 {
 	node_s *node = malloc(sizeof(node_s));
 	if (node == NULL) {
@@ -58,6 +84,69 @@ new_node (const char *name)	/* if not NULL, initialize node's name */
 	node->is_last_child = 1;
 	node->origindex = -1;
 	node->children_by_name = NULL;
+	node->nshown = 0;
+	node->rollup = NULL;
+	node->id = -1;
+	node_memory += sizeof(node_s) + sizeof(node_s *)
+		+ (name ? strlen(name) + 1 : 0);
+	return node;
+}
+
+/* Create a new node, initialize its contents, and return a pointer to it. */
+node_s *
+new_node (const char *name)	/* if not NULL, initialize node's name */
+{
+	node_s *node = alloc_node(name);
+
+	if (node_table_size >= node_table_alloc) {
+		node_table_alloc = node_table_alloc ? node_table_alloc * 2
+			: KIDSATATIME;
+		node_table = realloc(node_table,
+				     node_table_alloc * sizeof(node_s *));
+		if (!node_table) {
+			perror("new_node: realloc");
+			exit(1);
+		}
+	}
+	node->id = node_table_size;
+	node_table[node_table_size++] = node;
+	return node;
+}
+
+/* Create a node again in the slot of node_table it had before it was
+   freed. */
+node_s *
+new_node_at (const char *name, long id)
+{
+	node_s *node = alloc_node(name);
+
+	node->id = id;
+	node_table[id] = node;
+	return node;
+}
+
+/* Create a node that stands in for another one in a view built on top
+   of the tree, such as a filtered view.  It shares the original's name,
+   size and id, and is not listed in node_table. */
+node_s *
+new_view_node (node_s *orig)
+{
+	node_s *node = malloc(sizeof(node_s));
+	if (node == NULL) {
+		perror("new_view_node: malloc");
+		exit(1);
+	}
+	*node = *orig;
+	node->children = NULL;
+	node->nchildren = 0;
+	node->nchildrenblocks = 0;
+	node->children_by_name = NULL;
+	node->parent = NULL;
+	node->expanded = 0;
+	node->is_last_child = 1;
+	node->origindex = -1;
+	node->nshown = 0;
+	node->rollup = NULL;
 	return node;
 }
 
@@ -98,6 +187,74 @@ add_child (node_s *parent, node_s *child)
 	g_hash_table_insert(parent->children_by_name, child->name, child);
 }
 
+/* Take a child out of its parent's list, keeping the order of the rest.
+   The child itself is left alone, for the caller to free. */
+void
+remove_child (node_s *parent, node_s *child)
+{
+	long i;
+
+	for (i = 0; i < parent->nchildren; ++i)
+		if (parent->children[i] == child) break;
+	if (i == parent->nchildren) return;
+	memmove(parent->children + i, parent->children + i + 1,
+		(parent->nchildren - i - 1) * sizeof(node_s *));
+	if (--parent->nchildren)
+		parent->children[parent->nchildren - 1]->is_last_child = 1;
+	if (parent->children_by_name)
+		g_hash_table_remove(parent->children_by_name, child->name);
+	child->parent = NULL;
+
+	/* whether or not to roll up is decided again on expanding */
+	node_rollup_free(parent);
+	parent->nshown = 0;
+}
+
+static void node_unfold (node_s *node);
+
+/* The name lookup tables are thrown away after parsing (see
+   cleanup_tree()); put one back for a node whose children are about to
+   be looked up by name again, splitting up any folded chains among
+   them (see fold_tree()) so that each has its first name. */
+void
+node_index_children (node_s *node)
+{
+	long i;
+
+	if (node->children_by_name) return;
+	node_load_children(node);
+	for (i = 0; i < node->nchildren; ++i)
+		if (strchr(node->children[i]->name, '/'))
+			node_unfold(node->children[i]);
+	node->children_by_name = g_hash_table_new(g_str_hash, g_str_equal);
+	if (!node->children_by_name) {
+		perror("node_index_children: g_hash_table_new");
+		exit(1);
+	}
+	for (i = 0; i < node->nchildren; ++i)
+		g_hash_table_insert(node->children_by_name,
+				    node->children[i]->name,
+				    node->children[i]);
+}
+
+/* Does a node have children that aren't in memory, either written out
+   (see spill.c) or not read yet (see lazy.c and bfs.c)? */
+bool
+node_has_unloaded_children (const node_s *node)
+{
+	return spill_is_spilled(node) || lazy_is_lazy(node)
+		|| bfs_is_unread(node);
+}
+
+/* Bring them in, if so. */
+void
+node_load_children (node_s *node)
+{
+	spill_load(node);
+	lazy_load(node);
+	bfs_load(node);
+}
+
 /* Find an existing child with the specified name or create a new one.
    Returns it. */
 node_s *
@@ -109,6 +266,7 @@ find_or_create_child (node_s *node, const char *name)
 	if (!node || !name)
 		return NULL;
 
+	node_load_children(node);
 	if (node->children_by_name) {
 		found = g_hash_table_lookup(node->children_by_name, name);
 		if (found) {
@@ -122,27 +280,29 @@ find_or_create_child (node_s *node, const char *name)
 	return NULL;
 }
 
-/* Link a pathname into the tree and set the destination node's size. */
-void
+/* Link a pathname into the tree and set the destination node's size.
+   Returns the node. */
+node_s *
 add_node (node_s *root, const char *pathname, TDU_SIZE_T size)
 {
-	char *pathname_copy;
-	char *name;
+	char name[PATH_MAX];
+	const char *p, *end, *slash;
 	node_s *node;
 
-	if (!root || !pathname) return;
+	if (!root || !pathname) return NULL;
+	if (!root->parent && *pathname == '/')
+		tdu_absolute_paths = 1;	/* for node_path() */
 	
 	node = root;
 
-	pathname_copy = strdup(pathname);
-	if (!pathname_copy) {
-		perror("add_node: strdup");
-		exit(1);
-	}
-	name = strtok(pathname_copy, "/");
-	while (name) {
+	/* each run of characters between slashes is a name */
+	end = pathname + strlen(pathname);
+	for (p = pathname; p < end; p = slash + 1) {
+		slash = scan_char(p, end, '/');
+		if (slash == p || slash - p >= sizeof(name)) continue;
+		memcpy(name, p, slash - p);
+		name[slash - p] = '\0';
 		node = find_or_create_child(node, name);
-		name = strtok(NULL, "/");
 	}
 	node->size = size;
 
@@ -150,6 +310,7 @@ add_node (node_s *root, const char *pathname, TDU_SIZE_T size)
                 g_hash_table_destroy(node->children_by_name);
                 node->children_by_name = NULL;
         }
+	return node;
 }
 
 /* Recursively fix any nodes in a tree whose size is not yet specified.
@@ -172,7 +333,8 @@ fix_tree_sizes (node_s *node)
 	return node->size = size;
 }
 
-/* Recursively compute each node's number of descendents.
+/* Recursively compute each node's number of descendents, and sketch
+   the sizes of the files under each directory on the way back up.
    Returns number of descendents in specified node. */
 long
 fix_tree_descendents (node_s *node)
@@ -191,6 +353,7 @@ fix_tree_descendents (node_s *node)
 			descendents += fix_tree_descendents(node->children[i]);
 		}
 	}
+	sketch_merge(node);
 	return node->descendents = descendents;
 }
 
@@ -208,13 +371,128 @@ cleanup_tree (node_s *node)
 	}
 }
 
+/* Fold a directory whose only entry is another directory into it, as
+   the parent of that one's entries, under a compound name such as
+   srv/data.  The directory's own size stays, and the other's id goes
+   away. */
+static void
+node_fold (node_s *node)
+{
+	node_s *child = node->children[0];
+	char *name;
+	long i;
+
+	if (!(name = malloc(strlen(node->name) + strlen(child->name) + 2))) {
+		perror("node_fold: malloc");
+		exit(1);
+	}
+	sprintf(name, "%s/%s", node->name, child->name);
+	node_memory += strlen(child->name) + 1;
+
+	/* the parent's name lookup table points at the old name */
+	if (node->parent->children_by_name) {
+		g_hash_table_destroy(node->parent->children_by_name);
+		node->parent->children_by_name = NULL;
+	}
+	if (node->children_by_name) {
+		g_hash_table_destroy(node->children_by_name);
+		node->children_by_name = NULL;
+	}
+	free(node->name);
+	node->name = name;
+
+	free(node->children);
+	node->children = child->children;
+	node->nchildren = child->nchildren;
+	node->nchildrenblocks = child->nchildrenblocks;
+	for (i = 0; i < node->nchildren; ++i)
+		node->children[i]->parent = node;
+	/* node->descendents goes on counting the folded levels, as its
+	   ancestors' do, so that node_unfold() can give them back */
+	node_rollup_free(node);
+	node->nshown = 0;
+
+	child->children = NULL;
+	child->nchildren = 0;
+	child->nchildrenblocks = 0;
+	sketch_forget(child);
+	free_tree(child);
+}
+
+/* Split a node with a compound name after its first name, the rest
+   going to a new node that takes over everything in it. */
+static void
+node_unfold (node_s *node)
+{
+	char *slash = strchr(node->name, '/');
+	node_s *child = new_node(slash + 1);
+	long i;
+
+	node_memory -= strlen(slash + 1) + 1;
+	*slash = '\0';
+
+	child->children = node->children;
+	child->nchildren = node->nchildren;
+	child->nchildrenblocks = node->nchildrenblocks;
+	child->children_by_name = node->children_by_name;
+	for (i = 0; i < child->nchildren; ++i)
+		child->children[i]->parent = child;
+	child->size = node->size;
+	child->descendents = node->descendents - 1;
+	child->expanded = node->expanded;
+	child->nshown = node->nshown;
+	child->rollup = node->rollup;
+
+	node->children = NULL;
+	node->nchildren = 0;
+	node->nchildrenblocks = 0;
+	node->children_by_name = NULL;
+	node->nshown = 0;
+	node->rollup = NULL;
+	add_child(node, child);
+	g_hash_table_destroy(node->children_by_name);
+	node->children_by_name = NULL;	/* it's looked up by its first name */
+	sketch_merge(child);
+}
+
+/* Fold each chain of directories with only one entry apiece, such as
+   srv/data/projects/acme/builds, into a single node (see node_fold()),
+   which saves the nodes and the levels below them that have to be
+   gone through.  A chain comes apart again, one level at a time, if
+   what's in it is looked up by name (see node_index_children()).
+   Returns the number of nodes folded away. */
+long
+fold_tree (node_s *node)
+{
+	long folded = 0, i;
+
+	while (node->parent && node->nchildren == 1
+	       && node->children[0]->nchildren
+	       && strcmp(node->name, ".") && strcmp(node->name, "..")) {
+		node_fold(node);
+		++folded;
+	}
+	for (i = 0; i < node->nchildren; ++i)
+		folded += fold_tree(node->children[i]);
+	return folded;
+}
+
 /* "expand" a tree a certain level number of levels deep, or if -1 is
-   specified, all the way.  Returns total number of nodes made visible. */
+   specified, all the way.  Returns total number of nodes made visible.
+   "Expanding" a rollup shows the next page of the entries it holds. */
 long
 expand_tree (node_s *node, int level)
 {
 	node_s *p;
-	long ret = expand_tree_(node, level);
+	long ret;
+
+	if (node_is_rollup(node)) {
+		node = node->parent;
+		ret = node_rollup_more(node);
+	}
+	else {
+		ret = expand_tree_(node, level);
+	}
 
 	for (p = node->parent; p; p = p->parent)
 		p->expanded += ret;
@@ -228,19 +506,28 @@ expand_tree_ (node_s *node, int level)
 {
 	long ret = 0;
 	long expanded;
-	int i;
+	long i, n;
 
+	if (level && node_has_unloaded_children(node)) {
+		spill_trim();
+		node_load_children(node);
+	}
 	if (!(node && node->nchildren && node->children && level)) return 0;
 
 	/* if collapsed, expand this level */
-	if (!node->expanded) ret += (node->expanded = node->nchildren);
+	if (!node->expanded) {
+		node_rollup(node);
+		ret += (node->expanded = node_nvisible(node));
+	}
 
 	/* if any levels left, recursively call self on each of the
 	   children */    
 	if (level > 0) level -= 1;	/* how many levels left? */
 	if (level) {
-		for (i = 0; i < node->nchildren; ++i) {
-			expanded = expand_tree_(node->children[i], level);
+		n = node_nvisible(node);
+		for (i = 0; i < n; ++i) {
+			expanded = expand_tree_(node_visible_child(node, i),
+						level);
 			ret += expanded;
 			node->expanded += expanded;
 		}
@@ -273,18 +560,220 @@ collapse_tree (node_s *node)
 void
 collapse_tree_ (node_s *node)
 {
-	int i;
+	long i, n;
 	if (!(node && node->nchildren && node->children && node->expanded))
 		return;
 
 	node->expanded = 0;
-	for (i = 0; i < node->nchildren; ++i) {
-		collapse_tree_(node->children[i]);
+	n = node_nvisible(node);
+	for (i = 0; i < n; ++i) {
+		collapse_tree_(node_visible_child(node, i));
 	}
 }
 
 /******************************************************************************
 
+A directory with a huge number of entries would take as many lines to show,
+and expanding it would mean laying all of them out.  Instead, when a directory
+with more than tdu_rollup children is first expanded, only its tdu_rollup
+largest children are shown, followed by a "rollup" line standing in for all
+the rest:
+
+ 3     524288 +- spool
+ 4       8192 |  +- 1704210551.M1P2.mx
+   ...
+1003       4 |  +- 1704210934.M7P2.mx
+1004   401236 |  `- (498211 smaller entries)
+
+The children shown are kept at the front of the children array (in whatever
+order the tree is sorted in), the rest after them.  Expanding the rollup line
+moves the next tdu_rollup largest of the rest to the front, until none are
+left and the rollup goes away.
+
+******************************************************************************/
+
+/* The number of lines a node's children take up when it is expanded
+   (not counting their own descendents). */
+long
+node_nvisible (node_s *node)
+{
+	return node->rollup ? node->nshown + 1 : node->nchildren;
+}
+
+/* The ith of a node's visible children, including any rollup. */
+node_s *
+node_visible_child (node_s *node, long i)
+{
+	return (node->rollup && i == node->nshown) ? node->rollup
+		: node->children[i];
+}
+
+bool
+node_is_rollup (node_s *node)
+{
+	return node && node->parent && node->parent->rollup == node;
+}
+
+/* Move the k largest of the n nodes in a[] to the front, in no
+   particular order. */
+static void
+select_largest (node_s **a, long n, long k)
+{
+	long lo = 0, hi = n - 1;
+	long i, j;
+	long pivot;
+	node_s *t;
+
+	if (k <= 0 || k >= n) return;
+	while (lo < hi) {
+		pivot = a[(lo + hi) / 2]->size;
+		for (i = lo, j = hi; i <= j; ) {
+			while (a[i]->size > pivot) ++i;
+			while (a[j]->size < pivot) --j;
+			if (i <= j) {
+				t = a[i]; a[i] = a[j]; a[j] = t;
+				++i; --j;
+			}
+		}
+		if (k <= j) hi = j;
+		else if (k >= i + 1) lo = i;
+		else break;
+	}
+}
+
+static void sort_shown (node_s *node);
+
+static void
+rollup_name (node_s *node)
+{
+	snprintf(node->rollup->name, 64, "(%ld smaller entries)",
+		 node->nchildren - node->nshown);
+}
+
+/* Roll up all but the largest tdu_rollup of a node's children, if it
+   has too many and hasn't been rolled up before. */
+void
+node_rollup (node_s *node)
+{
+	node_s *r;
+	long i;
+
+	if (!node || node->nshown || tdu_rollup <= 0
+	    || node->nchildren <= tdu_rollup)
+		return;
+
+	select_largest(node->children, node->nchildren, tdu_rollup);
+	node->nshown = tdu_rollup;
+
+	r = malloc(sizeof(node_s));
+	if (r == NULL) {
+		perror("node_rollup: malloc");
+		exit(1);
+	}
+	if (!(r->name = malloc(64))) {
+		perror("node_rollup: malloc");
+		exit(1);
+	}
+	r->size = 0;
+	r->descendents = 0;
+	for (i = node->nshown; i < node->nchildren; ++i) {
+		r->size += node->children[i]->size;
+		r->descendents += 1 + node->children[i]->descendents;
+	}
+	r->children = NULL;
+	r->children_by_name = NULL;
+	r->nchildren = 0;
+	r->nchildrenblocks = 0;
+	r->parent = node;
+	r->expanded = 0;
+	r->is_last_child = 1;
+	r->origindex = -1;
+	r->id = -1;
+	r->nshown = 0;
+	r->rollup = NULL;
+	node->rollup = r;
+	rollup_name(node);
+	sort_shown(node);
+}
+
+/* Take children at index from onwards out of a node's rollup, freeing
+   the rollup if that was all of them.  Returns the change in the number
+   of lines the node's children take up. */
+static long
+rollup_take (node_s *node, long from, long to)
+{
+	long i;
+
+	for (i = from; i < to; ++i) {
+		node->rollup->size -= node->children[i]->size;
+		node->rollup->descendents -= 1 + node->children[i]->descendents;
+	}
+	node->nshown = to;
+	if (to < node->nchildren) {
+		rollup_name(node);
+		sort_shown(node);
+		return to - from;
+	}
+	node_rollup_free(node);
+	sort_shown(node);
+	return to - from - 1;
+}
+
+/* Show the next page of a node's rolled-up children.  Adjusts the
+   node's own count of visible lines, but not its ancestors'.  Returns
+   the change in that count. */
+long
+node_rollup_more (node_s *node)
+{
+	long from, to, ret;
+
+	if (!(node && node->rollup)) return 0;
+
+	from = node->nshown;
+	to = from + tdu_rollup;
+	if (tdu_rollup <= 0 || to > node->nchildren) to = node->nchildren;
+	select_largest(node->children + from, node->nchildren - from,
+		       to - from);
+	ret = rollup_take(node, from, to);
+	if (!node->expanded) return 0;
+	node->expanded += ret;
+	return ret;
+}
+
+/* Take one child out of its parent's rollup, if it's in it, so that
+   it can be shown. */
+void
+node_rollup_show (node_s *child)
+{
+	node_s *node = child ? child->parent : NULL;
+	node_s *p;
+	long i, ret;
+
+	if (!(node && node->rollup)) return;
+	for (i = node->nshown; i < node->nchildren; ++i)
+		if (node->children[i] == child) break;
+	if (i == node->nchildren) return; /* already shown */
+
+	node->children[i] = node->children[node->nshown];
+	node->children[node->nshown] = child;
+	ret = rollup_take(node, node->nshown, node->nshown + 1);
+	if (!node->expanded) return;
+	for (p = node; p; p = p->parent)
+		p->expanded += ret;
+}
+
+/* Free a node's rollup line, if it has one. */
+void
+node_rollup_free (node_s *node)
+{
+	if (!(node && node->rollup)) return;
+	free(node->rollup->name);
+	free(node->rollup);
+	node->rollup = NULL;
+}
+
+/******************************************************************************
+
 Okay, the next two functions may require a little explanation.  When using
 tdu, each visible node has a "line number".  The root node's line number is 0;
 each subsequent visible node has the next line number.
@@ -337,19 +826,23 @@ in each node.
 node_s *
 find_node_numbered (node_s *node, long nodeline)
 {
-	int i; long l;
+	long i, n; long l;
+	++perf_visited;
 	if (node && nodeline >= 0 && nodeline < (1 + node->expanded)) {
 		if (nodeline == 0) return node;
 		--nodeline;
 		if (node->expanded && node->children && node->nchildren) {
+			n = node_nvisible(node);
 			i = 0;
-			while (i < node->nchildren
+			while (i < n
 			       && (nodeline >=
-				   (l = 1 + node->children[i]->expanded))) {
+				   (l = 1 + node_visible_child(node, i)
+				    ->expanded))) {
 				nodeline -= l;
 				++i;
 			}
-			return find_node_numbered(node->children[i], nodeline);
+			return find_node_numbered(node_visible_child(node, i),
+						  nodeline);
 		}
 	}
 	return NULL;
@@ -360,7 +853,7 @@ long
 find_node_number_in (node_s *node, node_s *root)
 {
 	long n = 0;
-	int i;
+	long i, nvisible;
 
 	if (!node) return -1;
 
@@ -370,11 +863,12 @@ find_node_number_in (node_s *node, node_s *root)
 			return n;
 
 		++n;
-		for (i = 0; (i < parent->nchildren) && 
-			     (parent->children[i] != node); ++i)
-			n += (1 + parent->children[i]->expanded);
+		nvisible = node_nvisible(parent);
+		for (i = 0; (i < nvisible) && 
+			     (node_visible_child(parent, i) != node); ++i)
+			n += (1 + node_visible_child(parent, i)->expanded);
 
-		if (i == parent->nchildren) return -1; /* SHOULDN'T HAPPEN */
+		if (i == nvisible) return -1; /* rolled up, or SHOULDN'T HAPPEN */
 
 		node = parent;
 	}
@@ -395,10 +889,97 @@ node_cmp_unsort (const node_s *a, const node_s *b)
 	return (a->origindex - b->origindex);
 }
 
+/* Write bytes from of a name's sort key into buf, as many of them as
+   fit in size: the name itself, or for a natural sort
+   (tdu_natural_sort), the name with each run of digits written as a
+   '0', the number of digits leaving out leading zeros, and those
+   digits, so that file2 comes before file10.  Returns the whole key's
+   length. */
+static long
+name_key (const char *name, long from, unsigned char *buf, long size)
+{
+	const unsigned char *s = (const unsigned char *)name;
+	const unsigned char *digits;
+	long len = 0, n;
+
+#define NAME_KEY_PUT(c)	do {					\
+		if (len >= from && len - from < size)		\
+			buf[len - from] = (c);			\
+		++len;						\
+	} while (0)
+
+	if (!tdu_natural_sort) {
+		for (; *s; ++s)
+			NAME_KEY_PUT(*s);
+		return len;
+	}
+	while (*s) {
+		if (!isdigit(*s)) {
+			NAME_KEY_PUT(*s);
+			++s;
+			continue;
+		}
+		while (*s == '0' && isdigit(s[1])) ++s;
+		for (digits = s; isdigit(*s); ++s)
+			;
+		n = s - digits;
+		NAME_KEY_PUT('0');
+		NAME_KEY_PUT((n < 255) ? n : 255);
+		for (; digits < s; ++digits)
+			NAME_KEY_PUT(*digits);
+	}
+	return len;
+#undef NAME_KEY_PUT
+}
+
+/* Eight bytes of a name's sort key, from the given one on, packed so
+   that comparing two of them as numbers compares those bytes of the
+   keys.  A key that has ended is padded with 0, which no key has. */
+static unsigned long long
+name_key_prefix (const char *name, long from)
+{
+	unsigned char buf[sizeof(unsigned long long)];
+	unsigned long long prefix = 0;
+	long len = name_key(name, from, buf, sizeof(buf)) - from;
+	int i;
+
+	for (i = 0; i < sizeof(buf); ++i)
+		prefix = (prefix << 8) | ((i < len) ? buf[i] : 0);
+	return prefix;
+}
+
+/* Compare two names by their whole sort keys, or the names themselves
+   if the keys are the same (file02 and file2, say). */
+static int
+name_key_cmp (const char *a, const char *b)
+{
+	unsigned char bufa[1024], bufb[1024];
+	unsigned char *ka = bufa, *kb = bufb;
+	long la, lb;
+	int ret;
+
+	if (!tdu_natural_sort) return strcmp(a, b);
+	la = name_key(a, 0, NULL, 0);
+	lb = name_key(b, 0, NULL, 0);
+	if ((la > sizeof(bufa) && !(ka = malloc(la)))
+	    || (lb > sizeof(bufb) && !(kb = malloc(lb)))) {
+		perror("name_key_cmp: malloc");
+		exit(1);
+	}
+	name_key(a, 0, ka, la);
+	name_key(b, 0, kb, lb);
+	ret = memcmp(ka, kb, (la < lb) ? la : lb);
+	if (!ret) ret = (la > lb) - (la < lb);
+	if (!ret) ret = strcmp(a, b);
+	if (ka != bufa) free(ka);
+	if (kb != bufb) free(kb);
+	return ret;
+}
+
 int
 node_cmp_name (const node_s *a, const node_s *b)
 {
-	return strcmp(a->name, b->name); 
+	return name_key_cmp(a->name, b->name);
 }
 
 int
@@ -421,6 +1002,131 @@ node_qsort_cmp (const void *aa, const void *bb)
 	return ret;
 }
 
+/* Sorting by name works out the first eight bytes of each child's sort
+   key once, and sorts on those with a radix sort that touches nothing
+   but the array being sorted; children whose keys start the same are
+   then sorted on the next eight bytes, and so on, until there are few
+   enough of them for qsort() on the names to do. */
+typedef struct name_sort_entry {
+	unsigned long long prefix;
+	node_s *node;
+} name_sort_entry_s;
+
+/* below this many, a plain qsort() will do */
+#define NAME_RADIX_MIN 256
+
+static int
+name_sort_cmp (const void *aa, const void *bb)
+{
+	const name_sort_entry_s *a = aa;
+	const name_sort_entry_s *b = bb;
+	int ret = (a->prefix > b->prefix) - (a->prefix < b->prefix);
+
+	if (!ret) ret = name_key_cmp(a->node->name, b->node->name);
+	return ret;
+}
+
+/* Sort entries by prefix, a byte at a time from the last, skipping any
+   byte that's the same in all of them. */
+static void
+name_radix_sort (name_sort_entry_s *entries, long n)
+{
+	name_sort_entry_s *from = entries, *to, *tmp, *t;
+	long count[256], i, pos;
+	int shift, b;
+
+	if (!(tmp = malloc(n * sizeof(name_sort_entry_s)))) {
+		perror("name_radix_sort: malloc");
+		exit(1);
+	}
+	to = tmp;
+	for (shift = 0; shift < 64; shift += 8) {
+		memset(count, 0, sizeof(count));
+		for (i = 0; i < n; ++i)
+			++count[(from[i].prefix >> shift) & 0xff];
+		if (count[(from[0].prefix >> shift) & 0xff] == n)
+			continue;
+		for (b = 0, pos = 0; b < 256; ++b) {
+			long c = count[b];
+			count[b] = pos;
+			pos += c;
+		}
+		for (i = 0; i < n; ++i)
+			to[count[(from[i].prefix >> shift) & 0xff]++] = from[i];
+		t = from;
+		from = to;
+		to = t;
+	}
+	if (from != entries)
+		memcpy(entries, from, n * sizeof(name_sort_entry_s));
+	free(tmp);
+}
+
+/* Sort entries whose keys are the same before byte from. */
+static void
+name_sort_from (name_sort_entry_s *entries, long n, long from)
+{
+	long i, j;
+
+	for (i = 0; i < n; ++i)
+		entries[i].prefix = name_key_prefix(entries[i].node->name, from);
+	if (n < NAME_RADIX_MIN) {
+		qsort(entries, n, sizeof(name_sort_entry_s), name_sort_cmp);
+		return;
+	}
+	name_radix_sort(entries, n);
+	for (i = 0; i < n; i = j) {
+		for (j = i + 1; j < n && entries[j].prefix == entries[i].prefix;
+		     ++j)
+			;
+		if (j - i < 2)
+			continue;
+		if (entries[i].prefix & 0xff)	/* the keys go on */
+			name_sort_from(entries + i, j - i,
+				       from + sizeof(entries[i].prefix));
+		else
+			qsort(entries + i, j - i, sizeof(name_sort_entry_s),
+			      name_sort_cmp);
+	}
+}
+
+static void
+sort_by_name (node_s **nodes, long n)
+{
+	name_sort_entry_s *entries;
+	long i;
+
+	entries = malloc(n * sizeof(name_sort_entry_s));
+	if (!entries) {
+		perror("sort_by_name: malloc");
+		exit(1);
+	}
+	for (i = 0; i < n; ++i)
+		entries[i].node = nodes[i];
+	name_sort_from(entries, n, 0);
+	for (i = 0; i < n; ++i)
+		nodes[node_sort_rev ? n - 1 - i : i] = entries[i].node;
+	free(entries);
+}
+
+/* Sort the children of a node that are shown, using the last sort
+   order asked for.  Rolled-up children are left alone. */
+static void
+sort_shown (node_s *node)
+{
+	long i, n = node->rollup ? node->nshown : node->nchildren;
+
+	if (!n) return;
+	if (node_sort == node_cmp_name)
+		sort_by_name(node->children, n);
+	else
+		qsort(node->children, n, sizeof(node_s *), node_qsort_cmp);
+
+	for (i = 0; i < n - 1; ++i)
+		node->children[i]->is_last_child = 0;
+	node->children[i]->is_last_child = !node->rollup;
+}
+
 /* Recursively (or not) sort the children of a tree node. */
 void
 tree_sort (node_s *node, node_sort_fp fp, bool reverse, bool isrecursive)
@@ -433,12 +1139,7 @@ tree_sort (node_s *node, node_sort_fp fp, bool reverse, bool isrecursive)
 
 	node_sort = fp;
 	node_sort_rev = reverse;
-	qsort(node->children, node->nchildren, sizeof(node_s *),
-	      node_qsort_cmp);
-
-	for (i = 0; i < (node->nchildren-1); ++i)
-		node->children[i]->is_last_child = 0;
-	node->children[i]->is_last_child = 1;
+	sort_shown(node);
 
 	if (isrecursive) {
 		for (i = 0; i < node->nchildren; ++i) {
@@ -448,6 +1149,114 @@ tree_sort (node_s *node, node_sort_fp fp, bool reverse, bool isrecursive)
 	}
 }
 
+/* Split a line of du output into its size and pathname.  path must
+   have room for PATH_MAX characters.  Returns 0 if it isn't one. */
+bool
+parse_du_line (const char *line, TDU_SIZE_T *size, char *path)
+{
+	return parse_du_span(line, line + strlen(line), size, path);
+}
+
+/* The same, for a line that ends at end instead of at a NUL. */
+bool
+parse_du_span (const char *line, const char *end, TDU_SIZE_T *size,
+	       char *path)
+{
+	const char *p = line;
+	const char *nl = scan_char(line, end, '\n');
+
+	if (!scan_size(&p, nl, size)) return 0;
+	while (p < nl && isspace((unsigned char)*p)) ++p;
+	if (p == nl || nl - p >= PATH_MAX) return 0;
+	memcpy(path, p, nl - p);
+	path[nl - p] = '\0';
+	return 1;
+}
+
+/* Free a node and everything under it.  It must already have been
+   taken out of its parent's list of children. */
+void
+free_tree (node_s *node)
+{
+	long i;
+
+	if (!node) return;
+	for (i = 0; i < node->nchildren; ++i)
+		free_tree(node->children[i]);
+	node_rollup_free(node);
+	if (node->children_by_name)
+		g_hash_table_destroy(node->children_by_name);
+	free(node->children);
+	if (node->id >= 0 && node->id < node_table_size)
+		node_table[node->id] = NULL;
+	node_memory -= sizeof(node_s) + sizeof(node_s *)
+		+ (node->name ? strlen(node->name) + 1 : 0);
+	free(node->name);
+	free(node);
+}
+
+/* Make a list (by id, parents first) of the expanded nodes at or under
+   node, so that the tree can be collapsed and put back the way it was
+   with tree_restore_expanded().  Returns how many. */
+long
+tree_save_expanded (node_s *node, long **ids)
+{
+	long n = tree_list_expanded(node, NULL, 0);
+
+	*ids = malloc((n + 1) * sizeof(long));
+	if (!*ids) {
+		perror("tree_save_expanded: malloc");
+		exit(1);
+	}
+	tree_list_expanded(node, *ids, 0);
+	return n;
+}
+
+/* Does the counting (and, if ids is not NULL, listing) for
+   tree_save_expanded(). */
+long
+tree_list_expanded (node_s *node, long *ids, long n)
+{
+	long i, nvisible;
+
+	if (!node->expanded) return n;
+	if (ids) ids[n] = node->id;
+	++n;
+	nvisible = node_nvisible(node);
+	for (i = 0; i < nvisible; ++i)
+		n = tree_list_expanded(node_visible_child(node, i), ids, n);
+	return n;
+}
+
+/* Expand, one level each, the nodes listed by tree_save_expanded()
+   that still exist. */
+void
+tree_restore_expanded (const long *ids, long n)
+{
+	long i;
+
+	for (i = 0; i < n; ++i) {
+		node_s *node = (ids[i] >= 0 && ids[i] < node_table_size)
+			? node_table[ids[i]] : NULL;
+		if (node && !node->expanded)
+			expand_tree(node, 1);
+	}
+}
+
+/* Add one entry read by parse_file(). */
+static void
+parse_add (node_s *root, const char *path, TDU_SIZE_T size, long entries,
+	   int show_progress)
+{
+	node_s *added = add_node(root, path, size);
+
+	/* du lists a directory after everything in it */
+	if (tdu_memory_limit && node_memory > tdu_memory_limit)
+		spill_node(added);
+	if (show_progress && !(entries % 100))
+		fprintf(stderr, "  %ld entries\r", entries);
+}
+
 /* Parse output of du and create a tree structure.
    Specify "-" or NULL for the filename to read from stdin.
    Returns pointer to parent node. */
@@ -456,11 +1265,12 @@ parse_file (const char *pathname)
 {
 	node_s *node;
 	FILE *in;
-	char line[PATH_MAX+256]; /* store lines as they are read from a file */
 	char path[PATH_MAX];	 /* store pathnames as they are copied */
 	TDU_SIZE_T size;
 	long entries = 0;
 	int show_progress = isatty(fileno(stderr));
+	struct stat st;
+	void *map;
 
 	if (!pathname || !strcmp(pathname, "-")) {
 		in = stdin;
@@ -477,12 +1287,51 @@ parse_file (const char *pathname)
 	node = new_node(NULL);
 	node->name = "[root]";	/* no strdup necessary or wanted */
 
-	while (fgets(line, sizeof(line), in)) {
-		sscanf(line, TDU_SIZE_T_SCANF " %[^\n]\n", &size, path);
-		add_node(node, path, size);
-		++entries;
-		if (show_progress && !(entries % 100))
-			fprintf(stderr, "  %ld entries\r", entries);
+	/* a file is read in place; anything else, such as a pipe from du,
+	   is read by the stages in ingest.c.  Either may be an ncdu export
+	   instead of du output. */
+	if (in != stdin && !fstat(fileno(in), &st) && S_ISREG(st.st_mode)
+	    && st.st_size > 0
+	    && (map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+			   fileno(in), 0)) != MAP_FAILED) {
+		const char *p = map, *end = p + st.st_size;
+
+		madvise(map, st.st_size, MADV_SEQUENTIAL);
+		if (ncdu_detect(p, end)) {
+			entries = ncdu_parse(node, pathname, -1, p,
+					     st.st_size, show_progress);
+			p = end;
+		}
+		while (p < end) {
+			const char *nl = scan_char(p, end, '\n');
+			if (parse_du_span(p, nl, &size, path))
+				parse_add(node, path, size, ++entries,
+					  show_progress);
+			p = nl + 1;
+		}
+		munmap(map, st.st_size);
+	}
+	else {
+		ingest_s *ingest;
+		const char *entry;
+		char head[4096];
+		long nhead;
+
+		do {
+			nhead = read(fileno(in), head, sizeof(head));
+		} while (nhead < 0 && errno == EINTR);
+		if (nhead < 0) nhead = 0;
+		if (ncdu_detect(head, head + nhead)) {
+			entries = ncdu_parse(node, pathname, fileno(in), head,
+					     nhead, show_progress);
+		}
+		else {
+			ingest = ingest_start(fileno(in), head, nhead);
+			while (ingest_next(ingest, &size, &entry))
+				parse_add(node, entry, size, ++entries,
+					  show_progress);
+			ingest_finish(ingest);
+		}
 	}
 	if (show_progress) {
 		fprintf(stderr, "  %ld entries total\n", entries);
@@ -501,3 +1350,129 @@ parse_file (const char *pathname)
 	return node;
 }
 
+/* Write the pathname of a node into buf, the way du would have printed
+   it.  Returns the length of the pathname, which may be larger than
+   size if it was truncated. */
+int
+node_path (node_s *node, char *buf, int size)
+{
+	int len;
+
+	if (!node || !node->parent) {
+		if (size > 0) *buf = '\0';
+		return 0;
+	}
+	len = node_path(node->parent, buf, size);
+	if (node->parent->parent || (tdu_absolute_paths
+				     && strcmp(node->name, ".")
+				     && strcmp(node->name, ".."))) {
+		if (len < size) buf[len] = '/';
+		++len;
+	}
+	if (len < size)
+		snprintf(buf + len, size - len, "%s", node->name);
+	len += strlen(node->name);
+	if (len >= size && size > 0) buf[size - 1] = '\0';
+	return len;
+}
+
+/* Find the node for a pathname, split up the way add_node() does, or
+   return NULL.  Works once the children_by_name tables are gone. */
+node_s *
+find_node_path (node_s *root, const char *pathname)
+{
+	const char *name = pathname;
+	node_s *node = root;
+	long i;
+
+	for (;;) {
+		while (*name == '/') ++name;
+		if (!*name) return node;
+		/* a folded chain's compound name takes several at once */
+		for (i = 0; i < node->nchildren; ++i) {
+			int len = strlen(node->children[i]->name);
+			if (!strncmp(node->children[i]->name, name, len)
+			    && (!name[len] || name[len] == '/')) {
+				name += len;
+				break;
+			}
+		}
+		if (i == node->nchildren) return NULL;
+		node = node->children[i];
+	}
+}
+
+/* Expand each of a node's ancestors, outermost first, so that the node
+   becomes visible. */
+void
+node_reveal (node_s *node)
+{
+	if (!(node && node->parent)) return;
+	node_reveal(node->parent);
+	if (!node->parent->expanded)
+		expand_tree(node->parent, 1);
+	node_rollup_show(node);
+}
+
+/* Parse a size such as "100", "1.5G" or "512k".  A plain number is in
+   the same units as the input; a number with a suffix (B, K, M, G, T
+   or P, optionally followed by "iB" or "B") is converted from bytes
+   using tdu_block_size.  Returns 0 if it can't be parsed. */
+bool
+parse_size (const char *s, TDU_SIZE_T *size)
+{
+	char *end;
+	double value = strtod(s, &end);
+	double bytes = 1;
+	const char *units = "BKMGTP";
+	const char *unit;
+	int i;
+
+	if (end == s || value < 0) return 0;
+	if (!*end) {
+		*size = value;
+		return 1;
+	}
+	unit = strchr(units, toupper((unsigned char)*end));
+	if (!unit) return 0;
+	for (i = 0; i < unit - units; ++i)
+		bytes *= 1024;
+	++end;
+	if (unit != units) {
+		if (*end == 'i') ++end;
+		if (toupper((unsigned char)*end) == 'B') ++end;
+	}
+	if (*end) return 0;
+	*size = value * bytes / tdu_block_size;
+	return 1;
+}
+
+/* Write v into p as a variable-length integer, seven bits to a byte,
+   lowest first, each byte but the last with its high bit set.  p must
+   have room for VARINT_MAX bytes.  Returns how many it took. */
+int
+varint_put (unsigned char *p, unsigned long long v)
+{
+	int len = 0;
+
+	do {
+		p[len++] = (v & 0x7f) | ((v > 0x7f) ? 0x80 : 0);
+		v >>= 7;
+	} while (v);
+	return len;
+}
+
+/* Read a variable-length integer at *p, moving *p past it. */
+unsigned long long
+varint_get (const unsigned char **p)
+{
+	unsigned long long v = 0;
+	int shift = 0;
+
+	do {
+		v |= (unsigned long long)(**p & 0x7f) << shift;
+		shift += 7;
+	} while (*(*p)++ & 0x80);
+	return v;
+}
+
@@ -31,6 +31,9 @@
 /* Each node's list of children is allocated in blocks of this many. */
 #define KIDSATATIME 256
 
+/* the most bytes varint_put() takes for one number */
+#define VARINT_MAX 10
+
 /* Each pathname element has associated with it a node in a tree. */
 typedef struct node {
 	char *name;
@@ -45,21 +48,50 @@ typedef struct node {
 	long descendents;
 	bool is_last_child;	/* used for printing tree branches */
 	int origindex;		/* for "unsorting" */
+	long id;		/* index into node_table */
+	long nshown;		/* children shown, if some are rolled up */
+	struct node *rollup;	/* stands in for the rest, or NULL */
 } node_s;
 
+extern long tdu_block_size;
+extern long tdu_rollup;
+extern bool tdu_fold;
+extern bool tdu_natural_sort;
+extern bool tdu_absolute_paths;
+
+/* Every node ever created, indexed by id.  Slots of nodes that have
+   been freed are NULL. */
+extern node_s **node_table;
+extern long node_table_size;
+extern long node_memory;
+
 typedef int (*node_sort_fp)(const node_s *, const node_s *);
 
 node_s *new_node (const char *name);
+node_s *new_node_at (const char *name, long id);
+node_s *new_view_node (node_s *orig);
 void add_child (node_s *parent, node_s *child);
+void remove_child (node_s *parent, node_s *child);
+void node_index_children (node_s *node);
+bool node_has_unloaded_children (const node_s *node);
+void node_load_children (node_s *node);
 node_s *find_or_create_child (node_s *node, const char *name);
-void add_node (node_s *root, const char *pathname, TDU_SIZE_T size);
+node_s *add_node (node_s *root, const char *pathname, TDU_SIZE_T size);
 TDU_SIZE_T fix_tree_sizes (node_s *node);
 long fix_tree_descendents (node_s *node);
 void cleanup_tree (node_s *node);
+long fold_tree (node_s *node);
 void dump_tree (node_s *node, int level);
 long expand_tree (node_s *node, int level);
 long expand_tree_ (node_s *node, int level);
 long collapse_tree (node_s *node);
+long node_nvisible (node_s *node);
+node_s *node_visible_child (node_s *node, long i);
+bool node_is_rollup (node_s *node);
+void node_rollup (node_s *node);
+long node_rollup_more (node_s *node);
+void node_rollup_show (node_s *child);
+void node_rollup_free (node_s *node);
 void collapse_tree_ (node_s *node);
 node_s *find_node_numbered (node_s *node, long nodeline);
 long find_node_number_in (node_s *node, node_s *root);
@@ -69,7 +101,20 @@ int node_cmp_name (const node_s *a, const node_s *b);
 int node_cmp_descendents (const node_s *a, const node_s *b);
 int node_qsort_cmp (const void *aa, const void *bb);
 void tree_sort (node_s *node, node_sort_fp fp, bool reverse, bool isrecursive);
+bool parse_du_line (const char *line, TDU_SIZE_T *size, char *path);
+bool parse_du_span (const char *line, const char *end, TDU_SIZE_T *size,
+		    char *path);
+void free_tree (node_s *node);
+long tree_save_expanded (node_s *node, long **ids);
+long tree_list_expanded (node_s *node, long *ids, long n);
+void tree_restore_expanded (const long *ids, long n);
 node_s *parse_file (const char *pathname);
+int node_path (node_s *node, char *buf, int size);
+node_s *find_node_path (node_s *root, const char *pathname);
+void node_reveal (node_s *node);
+bool parse_size (const char *s, TDU_SIZE_T *size);
+int varint_put (unsigned char *p, unsigned long long v);
+unsigned long long varint_get (const unsigned char **p);
 
 /*****************************************************************************/
 #endif /* NODE_H */
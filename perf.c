@@ -0,0 +1,117 @@
+/*
+ * perf.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "perf.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Timings for the performance overlay, and the trace file named by
+   TDU_TRACE, to which every key handled is logged with how long it
+   took and how many nodes it looked at. */
+
+long perf_visited = 0;
+perf_stat_s perf_frame = { "frame", 0, 0 };
+perf_stat_s perf_op = { "none", 0, 0 };
+
+static FILE *trace_file = NULL;
+static bool trace_opened = 0;
+static double trace_start = 0;
+
+/* milliseconds, with fractions, on a clock that doesn't jump around */
+double
+perf_clock ()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* Start timing something.  Until perf_stop(), ms holds the start time
+   and visited the count so far. */
+void
+perf_start (perf_stat_s *stat, const char *what)
+{
+	stat->what = what;
+	stat->ms = perf_clock();
+	stat->visited = perf_visited;
+}
+
+void
+perf_stop (perf_stat_s *stat)
+{
+	stat->ms = perf_clock() - stat->ms;
+	stat->visited = perf_visited - stat->visited;
+}
+
+/* resident set size in kilobytes, or -1 if it can't be found out */
+long
+perf_rss ()
+{
+	FILE *f = fopen("/proc/self/statm", "r");
+	long size, resident = -1;
+
+	if (!f) return -1;
+	if (fscanf(f, "%ld %ld", &size, &resident) != 2)
+		resident = -1;
+	fclose(f);
+	return resident < 0 ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+bool
+perf_tracing ()
+{
+	const char *name;
+
+	if (!trace_opened) {
+		trace_opened = 1;
+		trace_start = perf_clock();
+		if ((name = getenv("TDU_TRACE")) && *name) {
+			if (!(trace_file = fopen(name, "a")))
+				perror(name);
+		}
+	}
+	return trace_file != NULL;
+}
+
+/* Write a line to the trace file, if there is one, after the time in
+   milliseconds since the first one. */
+void
+perf_vtrace (const char *fmt, va_list ap)
+{
+	if (!perf_tracing()) return;
+	fprintf(trace_file, "%10.3f ", perf_clock() - trace_start);
+	vfprintf(trace_file, fmt, ap);
+	fflush(trace_file);
+}
+
+void
+perf_trace (const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	perf_vtrace(fmt, ap);
+	va_end(ap);
+}
@@ -0,0 +1,51 @@
+/*
+ * perf.h
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#ifndef PERF_H
+#define PERF_H
+/*****************************************************************************/
+
+#include "tdu.h"
+#include "node.h"
+#include <stdarg.h>
+
+/* how long something took and how many nodes it looked at */
+typedef struct perf_stat {
+	const char *what;
+	double ms;
+	long visited;
+} perf_stat_s;
+
+/* nodes looked at by display_nodes_() and find_node_numbered() */
+extern long perf_visited;
+extern perf_stat_s perf_frame;	/* the last redraw */
+extern perf_stat_s perf_op;	/* the last sort, expand or collapse */
+
+double perf_clock (void);
+void perf_start (perf_stat_s *stat, const char *what);
+void perf_stop (perf_stat_s *stat);
+long perf_rss (void);
+bool perf_tracing (void);
+void perf_trace (const char *fmt, ...);
+void perf_vtrace (const char *fmt, va_list ap);
+
+/*****************************************************************************/
+#endif /* PERF_H */
@@ -0,0 +1,242 @@
+/*
+ * replay.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "tduint.h"
+#include "perf.h"
+#include "replay.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <curses.h>
+
+/* Replaying a script of keys against the interface, drawn offscreen, to
+   see how long each one takes.  Each line of the script is a run of keys
+   and an optional count, written xN, of times to repeat it:
+
+	l j l		# keys, separated by spaces
+	*
+	PGDN x20	# the same key, twenty times
+	END
+
+   Names stand for the keys that can't be typed: UP DOWN LEFT RIGHT PGUP
+   PGDN HOME END SPACE.  Keys that prompt, or that wait for a key before
+   going on, can't be replayed; nor can x, which would quit.
+
+   The timings are gathered by line of the script, and the state of the
+   cursor and of the expanded counts is checked after every key. */
+
+#define REPLAY_MAX_KEYS 64
+
+typedef struct replay_line {
+	char label[64];
+	double *ms;
+	long n, alloc;
+} replay_line_s;
+
+static const struct {
+	const char *name;
+	int key;
+} key_names[] = {
+	{ "UP", KEY_UP },
+	{ "DOWN", KEY_DOWN },
+	{ "LEFT", KEY_LEFT },
+	{ "RIGHT", KEY_RIGHT },
+	{ "PGUP", KEY_PPAGE },
+	{ "PGDN", KEY_NPAGE },
+	{ "HOME", KEY_HOME },
+	{ "END", KEY_END },
+	{ "SPACE", ' ' },
+};
+
+/* Returns the key a word of the script stands for, or ERR. */
+static int
+replay_key (const char *word)
+{
+	int i;
+
+	for (i = 0; i < sizeof(key_names) / sizeof(key_names[0]); ++i)
+		if (!strcmp(word, key_names[i].name))
+			return key_names[i].key;
+	if (!word[0] || word[1] || strchr("/~fFtTzZeErRcC?qQxX", word[0]))
+		return ERR;
+	return (unsigned char) word[0];
+}
+
+/* Check that each expanded node counts the lines of its visible
+   children.  Returns the number of lines under node, or -1. */
+static long
+replay_check_expanded (node_s *node)
+{
+	long i, n, lines = 0, sub;
+
+	if (!node->expanded)
+		return 0;
+	n = node_nvisible(node);
+	for (i = 0; i < n; ++i) {
+		if ((sub = replay_check_expanded(node_visible_child(node, i)))
+		    < 0)
+			return -1;
+		lines += 1 + sub;
+	}
+	if (lines != node->expanded) {
+		fprintf(stderr, "replay: %s counts %ld lines, has %ld\n",
+			node->name, node->expanded, lines);
+		return -1;
+	}
+	return lines;
+}
+
+/* Returns nonzero if the cursor or the tree is in a bad state. */
+static int
+replay_check ()
+{
+	if (cursor_line < 0 || cursor_line > root_node->expanded) {
+		fprintf(stderr, "replay: cursor on line %d of %ld\n",
+			cursor_line, root_node->expanded);
+		return 1;
+	}
+	if (cursor_line < start_line
+	    || cursor_line >= start_line + visible_lines) {
+		fprintf(stderr, "replay: cursor on line %d, showing %d-%d\n",
+			cursor_line, start_line,
+			start_line + visible_lines - 1);
+		return 1;
+	}
+	return replay_check_expanded(root_node) < 0;
+}
+
+static int
+replay_cmp_ms (const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+static void
+replay_report (replay_line_s *line)
+{
+	double *ms = line->ms;
+	long n = line->n;
+
+	if (!n) return;
+	qsort(ms, n, sizeof(*ms), replay_cmp_ms);
+	printf("%-24s %7ld %9.3f %9.3f %9.3f %9.3f\n", line->label, n,
+	       ms[n / 2], ms[n * 9 / 10], ms[n * 99 / 100], ms[n - 1]);
+}
+
+static void
+replay_time (replay_line_s *line, double ms)
+{
+	if (line->n == line->alloc) {
+		line->alloc = line->alloc ? line->alloc * 2 : 64;
+		line->ms = realloc(line->ms, line->alloc * sizeof(*line->ms));
+		if (!line->ms) {
+			perror("replay_time: realloc");
+			exit(1);
+		}
+	}
+	line->ms[line->n++] = ms;
+}
+
+/* Replay the keys in script against the tree under root, printing how
+   long they took.  Returns nonzero if the script couldn't be read or
+   the interface went wrong. */
+int
+replay_run (node_s *root, const char *script)
+{
+	FILE *fp;
+	char buf[1024];
+	int keys[REPLAY_MAX_KEYS];
+	int lineno = 0, failed = 0;
+
+	if (!(fp = fopen(script, "r"))) {
+		perror(script);
+		return 1;
+	}
+	if (!getenv("LINES")) setenv("LINES", "25", 0);
+	if (!getenv("COLUMNS")) setenv("COLUMNS", "80", 0);
+	tdu_interface_set_root(root);
+	tdu_interface_init_offscreen();
+	tdu_interface_flush();
+
+	printf("%-24s %7s %9s %9s %9s %9s\n", "# keys", "count",
+	       "p50 ms", "p90 ms", "p99 ms", "max ms");
+	while (!failed && fgets(buf, sizeof(buf), fp)) {
+		replay_line_s line = { "", NULL, 0, 0 };
+		char *p, *word;
+		long count = 1, i;
+		int j, nkeys = 0;
+
+		++lineno;
+		if ((p = strchr(buf, '#'))) *p = '\0';
+		for (word = strtok(buf, " \t\n"); word;
+		     word = strtok(NULL, " \t\n")) {
+			if (word[0] == 'x' && isdigit((unsigned char) word[1])) {
+				if ((count = atol(word + 1)) < 1) {
+					fprintf(stderr, "%s:%d: bad count %s\n",
+						script, lineno, word);
+					failed = 1;
+					break;
+				}
+			}
+			else if (nkeys == REPLAY_MAX_KEYS
+				 || (keys[nkeys++] = replay_key(word)) == ERR) {
+				fprintf(stderr, "%s:%d: can't replay %s\n",
+					script, lineno, word);
+				failed = 1;
+				break;
+			}
+			else if (strlen(line.label) + strlen(word) + 2
+				 < sizeof(line.label)) {
+				if (line.label[0]) strcat(line.label, " ");
+				strcat(line.label, word);
+			}
+		}
+		if (failed || !nkeys) continue;
+		if (count > 1) {
+			long len = strlen(line.label);
+			snprintf(line.label + len, sizeof(line.label) - len,
+				 " x%ld", count);
+		}
+
+		for (i = 0; i < count && !failed; ++i) {
+			for (j = 0; j < nkeys && !failed; ++j) {
+				double start = perf_clock();
+				tdu_interface_keypress(keys[j]);
+				tdu_interface_flush();
+				replay_time(&line, perf_clock() - start);
+				if (replay_check()) {
+					fprintf(stderr, "%s:%d: after %s\n",
+						script, lineno, line.label);
+					failed = 1;
+				}
+			}
+		}
+		replay_report(&line);
+		free(line.ms);
+	}
+	fclose(fp);
+	endwin();
+	return failed;
+}
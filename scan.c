@@ -0,0 +1,130 @@
+/*
+ * scan.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "scan.h"
+#include <string.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+/* Finding newlines in the input and slashes in pathnames is most of
+   the work of reading du's output, so it's done 16 or 32 bytes at a
+   time where the processor can: each chunk is compared against the
+   character and the first match found from the resulting bit mask.
+   The version used is picked the first time it's needed. */
+
+typedef const char *(*scan_fp)(const char *, const char *, int);
+
+static const char *
+scan_char_scalar (const char *p, const char *end, int c)
+{
+	while (p < end && *p != c) ++p;
+	return p;
+}
+
+#ifdef SCAN_X86
+__attribute__((target("sse2")))
+static const char *
+scan_char_sse2 (const char *p, const char *end, int c)
+{
+	__m128i want = _mm_set1_epi8((char)c);
+
+	for (; end - p >= 16; p += 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i *)p);
+		int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, want));
+		if (mask) return p + __builtin_ctz(mask);
+	}
+	return scan_char_scalar(p, end, c);
+}
+
+__attribute__((target("avx2")))
+static const char *
+scan_char_avx2 (const char *p, const char *end, int c)
+{
+	__m256i want = _mm256_set1_epi8((char)c);
+
+	for (; end - p >= 32; p += 32) {
+		__m256i chunk = _mm256_loadu_si256((const __m256i *)p);
+		unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk,
+								       want));
+		if (mask) return p + __builtin_ctz(mask);
+	}
+	/* not scan_char_sse2(): mixing its instructions with these would
+	   cost more than the scalar loop */
+	if (end - p >= 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i *)p);
+		int mask = _mm_movemask_epi8(
+			_mm_cmpeq_epi8(chunk, _mm256_castsi256_si128(want)));
+		if (mask) return p + __builtin_ctz(mask);
+		p += 16;
+	}
+	return scan_char_scalar(p, end, c);
+}
+#endif
+
+static const char *scan_char_pick (const char *p, const char *end, int c);
+
+static scan_fp scan_impl = scan_char_pick;
+
+static const char *
+scan_char_pick (const char *p, const char *end, int c)
+{
+	scan_fp impl = scan_char_scalar;
+
+#ifdef SCAN_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		impl = scan_char_avx2;
+	}
+	else if (__builtin_cpu_supports("sse2")) {
+		impl = scan_char_sse2;
+	}
+#endif
+	scan_impl = impl;
+	return impl(p, end, c);
+}
+
+/* The first c at or after p and before end, or end. */
+const char *
+scan_char (const char *p, const char *end, int c)
+{
+	return scan_impl(p, end, c);
+}
+
+/* Read a size (blanks, then digits) at *p, leaving *p after it. */
+bool
+scan_size (const char **p, const char *end, TDU_SIZE_T *size)
+{
+	const char *s = *p;
+	TDU_SIZE_T n = 0;
+
+	while (s < end && (*s == ' ' || *s == '\t')) ++s;
+	if (s == end || (unsigned)(*s - '0') > 9) return 0;
+	do {
+		n = n * 10 + (*s++ - '0');
+	} while (s < end && (unsigned)(*s - '0') <= 9);
+	*size = n;
+	*p = s;
+	return 1;
+}
@@ -0,0 +1,561 @@
+/*
+ * search.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "search.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <regex.h>
+#include <pthread.h>
+#include <glib.h>
+
+/* The search index maps each distinct name to the nodes bearing it, and
+   each (hashed) trigram to the distinct names containing it.  Both maps
+   are stored as an array of start offsets into one flat array of ids;
+   every list is in ascending order, so lists can be intersected by
+   binary search.
+
+   The index is built by a separate thread right after the tree has been
+   read.  That thread only reads node_table and node names, so nothing
+   that creates or frees nodes may run while it is working; such code
+   must call search_index_invalidate() first. */
+
+#define TRIGRAM_BUCKETS (1L << TRIGRAM_BITS)
+#define NO_NAME ((guint32)-1)
+
+typedef struct search_index {
+	long nnodes;		/* node_table_size when built */
+	long nnames;		/* number of distinct names */
+	char **names;		/* strings owned by the nodes */
+	long *name_start;	/* nodes named names[i] are listed in */
+	long *name_nodes;	/* name_nodes[name_start[i]..name_start[i+1]] */
+	long *tri_start;	/* names containing trigram bucket t are in */
+	guint32 *tri_names;	/* tri_names[tri_start[t]..tri_start[t+1]] */
+} search_index_s;
+
+static search_index_s *search_index = NULL;
+static pthread_t search_thread;
+static bool search_thread_running = 0;
+
+static guint32
+trigram_bucket (const char *s)
+{
+	guint32 t = (((guint32)(unsigned char)s[0] << 16)
+		     | ((guint32)(unsigned char)s[1] << 8)
+		     | (guint32)(unsigned char)s[2]);
+	return (t * 2654435761U) >> (32 - TRIGRAM_BITS);
+}
+
+static int
+guint32_cmp (const void *aa, const void *bb)
+{
+	guint32 a = *(const guint32 *)aa;
+	guint32 b = *(const guint32 *)bb;
+	return (a > b) - (a < b);
+}
+
+static int
+long_cmp (const void *aa, const void *bb)
+{
+	long a = *(const long *)aa;
+	long b = *(const long *)bb;
+	return (a > b) - (a < b);
+}
+
+/* Put the distinct trigram buckets of a string into *buckets, which is
+   (re)allocated as needed.  Returns how many there are. */
+static long
+string_buckets (const char *s, guint32 **buckets, long *alloc)
+{
+	long len = strlen(s);
+	long n, i, j;
+
+	if (len < 3) return 0;
+	if (len - 2 > *alloc) {
+		*alloc = len - 2;
+		*buckets = realloc(*buckets, *alloc * sizeof(guint32));
+		if (!*buckets) {
+			perror("string_buckets: realloc");
+			exit(1);
+		}
+	}
+	for (n = 0; n + 2 < len; ++n)
+		(*buckets)[n] = trigram_bucket(s + n);
+	qsort(*buckets, n, sizeof(guint32), guint32_cmp);
+	for (i = j = 0; i < n; ++i)
+		if (!j || (*buckets)[j - 1] != (*buckets)[i])
+			(*buckets)[j++] = (*buckets)[i];
+	return j;
+}
+
+static void *
+xmalloc (size_t size, const char *who)
+{
+	void *p = malloc(size ? size : 1);
+	if (!p) {
+		perror(who);
+		exit(1);
+	}
+	return p;
+}
+
+static search_index_s *
+search_index_build (long nnodes)
+{
+	search_index_s *index;
+	GHashTable *ids;
+	guint32 *node_name;
+	guint32 *buckets = NULL;
+	long nbuckets = 0;
+	long names_alloc = KIDSATATIME;
+	long i, j, k, total;
+
+	index = xmalloc(sizeof(search_index_s), "search_index_build: malloc");
+	index->nnodes = nnodes;
+	index->nnames = 0;
+	index->names = xmalloc(names_alloc * sizeof(char *),
+			       "search_index_build: malloc");
+
+	/* intern the names */
+	ids = g_hash_table_new(g_str_hash, g_str_equal);
+	node_name = xmalloc(nnodes * sizeof(guint32),
+			    "search_index_build: malloc");
+	for (i = 0; i < nnodes; ++i) {
+		node_s *node = node_table[i];
+		gpointer found;
+
+		if (!(node && node->parent)) {
+			node_name[i] = NO_NAME;
+			continue;
+		}
+		found = g_hash_table_lookup(ids, node->name);
+		if (found) {
+			node_name[i] = GPOINTER_TO_UINT(found) - 1;
+			continue;
+		}
+		if (index->nnames >= names_alloc) {
+			names_alloc *= 2;
+			index->names = realloc(index->names,
+					       names_alloc * sizeof(char *));
+			if (!index->names) {
+				perror("search_index_build: realloc");
+				exit(1);
+			}
+		}
+		index->names[index->nnames] = node->name;
+		g_hash_table_insert(ids, node->name,
+				    GUINT_TO_POINTER(index->nnames + 1));
+		node_name[i] = index->nnames++;
+	}
+	g_hash_table_destroy(ids);
+
+	/* Both lists are filled the same way: count each list's length
+	   into its start offset, turn the counts into end offsets, then
+	   place ids in descending order, backing each offset up to where
+	   its list starts. */
+
+	index->name_start = calloc(index->nnames + 1, sizeof(long));
+	if (!index->name_start) {
+		perror("search_index_build: calloc");
+		exit(1);
+	}
+	for (i = 0; i < nnodes; ++i)
+		if (node_name[i] != NO_NAME)
+			++index->name_start[node_name[i]];
+	for (total = 0, i = 0; i < index->nnames; ++i)
+		index->name_start[i] = (total += index->name_start[i]);
+	index->name_start[index->nnames] = total;
+	index->name_nodes = xmalloc(total * sizeof(long),
+				    "search_index_build: malloc");
+	for (i = nnodes - 1; i >= 0; --i)
+		if (node_name[i] != NO_NAME)
+			index->name_nodes[--index->name_start[node_name[i]]]
+				= i;
+	free(node_name);
+
+	index->tri_start = calloc(TRIGRAM_BUCKETS + 1, sizeof(long));
+	if (!index->tri_start) {
+		perror("search_index_build: calloc");
+		exit(1);
+	}
+	for (i = 0; i < index->nnames; ++i) {
+		k = string_buckets(index->names[i], &buckets, &nbuckets);
+		for (j = 0; j < k; ++j)
+			++index->tri_start[buckets[j]];
+	}
+	for (total = 0, i = 0; i < TRIGRAM_BUCKETS; ++i)
+		index->tri_start[i] = (total += index->tri_start[i]);
+	index->tri_start[TRIGRAM_BUCKETS] = total;
+	index->tri_names = xmalloc(total * sizeof(guint32),
+				   "search_index_build: malloc");
+	for (i = index->nnames - 1; i >= 0; --i) {
+		k = string_buckets(index->names[i], &buckets, &nbuckets);
+		for (j = 0; j < k; ++j)
+			index->tri_names[--index->tri_start[buckets[j]]] = i;
+	}
+	free(buckets);
+
+	return index;
+}
+
+static void *
+search_index_thread (void *data)
+{
+	return search_index_build((long)data);
+}
+
+/* Start building the search index in the background. */
+void
+search_index_start ()
+{
+	search_index_invalidate();
+	if (pthread_create(&search_thread, NULL, search_index_thread,
+			   (void *)node_table_size)) {
+		perror("search_index_start: pthread_create");
+		exit(1);
+	}
+	search_thread_running = 1;
+}
+
+/* Wait for the background thread, if any, to finish the index. */
+void
+search_index_wait ()
+{
+	void *result;
+
+	if (!search_thread_running) return;
+	if (pthread_join(search_thread, &result)) {
+		perror("search_index_wait: pthread_join");
+		exit(1);
+	}
+	search_thread_running = 0;
+	search_index = result;
+}
+
+/* Throw the index away; it will be rebuilt the next time it's needed. */
+void
+search_index_invalidate ()
+{
+	search_index_wait();
+	if (!search_index) return;
+	free(search_index->names);
+	free(search_index->name_start);
+	free(search_index->name_nodes);
+	free(search_index->tri_start);
+	free(search_index->tri_names);
+	free(search_index);
+	search_index = NULL;
+}
+
+static search_index_s *
+search_index_get ()
+{
+	search_index_wait();
+	if (!search_index)
+		search_index = search_index_build(node_table_size);
+	return search_index;
+}
+
+static bool
+tri_list_contains (search_index_s *index, guint32 bucket, guint32 name)
+{
+	guint32 *list = index->tri_names + index->tri_start[bucket];
+	long lo = 0, hi = index->tri_start[bucket + 1]
+		- index->tri_start[bucket];
+
+	while (lo < hi) {
+		long mid = (lo + hi) / 2;
+		if (list[mid] < name) lo = mid + 1;
+		else if (list[mid] > name) hi = mid;
+		else return 1;
+	}
+	return 0;
+}
+
+/* result list that grows as needed */
+typedef struct results {
+	long *ids;
+	long n;
+	long alloc;
+} results_s;
+
+static void
+results_add (results_s *r, long id)
+{
+	if (r->n >= r->alloc) {
+		r->alloc = r->alloc ? r->alloc * 2 : KIDSATATIME;
+		r->ids = realloc(r->ids, r->alloc * sizeof(long));
+		if (!r->ids) {
+			perror("results_add: realloc");
+			exit(1);
+		}
+	}
+	r->ids[r->n++] = id;
+}
+
+static void
+results_add_name (results_s *r, search_index_s *index, long name)
+{
+	long i;
+	for (i = index->name_start[name]; i < index->name_start[name + 1]; ++i)
+		if (node_table[index->name_nodes[i]])
+			results_add(r, index->name_nodes[i]);
+}
+
+/* Find the distinct names that may contain literal: all of them if it is
+   too short to have a trigram, otherwise those in every one of its
+   trigrams' posting lists.  Calls fp on each. */
+static void
+search_each_name (search_index_s *index, const char *literal,
+		  void (*fp)(search_index_s *, long, const void *, results_s *),
+		  const void *data, results_s *r)
+{
+	guint32 *buckets = NULL;
+	long nbuckets = 0;
+	long k, i, j, shortest;
+
+	k = string_buckets(literal, &buckets, &nbuckets);
+	if (!k) {
+		for (i = 0; i < index->nnames; ++i)
+			fp(index, i, data, r);
+		return;
+	}
+
+	/* walk the shortest list and look for each name in the others */
+	shortest = 0;
+	for (j = 1; j < k; ++j)
+		if (index->tri_start[buckets[j] + 1] - index->tri_start[buckets[j]]
+		    < (index->tri_start[buckets[shortest] + 1]
+		       - index->tri_start[buckets[shortest]]))
+			shortest = j;
+	for (i = index->tri_start[buckets[shortest]];
+	     i < index->tri_start[buckets[shortest] + 1]; ++i) {
+		guint32 name = index->tri_names[i];
+		for (j = 0; j < k; ++j)
+			if (j != shortest
+			    && !tri_list_contains(index, buckets[j], name))
+				break;
+		if (j == k)
+			fp(index, name, data, r);
+	}
+	free(buckets);
+}
+
+static void
+add_if_substring (search_index_s *index, long name, const void *data,
+		  results_s *r)
+{
+	if (strstr(index->names[name], (const char *)data))
+		results_add_name(r, index, name);
+}
+
+static void
+add_if_regex (search_index_s *index, long name, const void *data,
+	      results_s *r)
+{
+	if (!regexec((const regex_t *)data, index->names[name], 0, NULL, 0))
+		results_add_name(r, index, name);
+}
+
+/* Ids of the nodes whose names contain literal, in ascending order.
+   Returns how many. */
+long
+search_candidates (const char *literal, long **results)
+{
+	results_s r = { NULL, 0, 0 };
+	search_index_s *index = search_index_get();
+
+	search_each_name(index, literal, add_if_substring, literal, &r);
+	qsort(r.ids, r.n, sizeof(long), long_cmp);
+	*results = r.ids;
+	return r.n;
+}
+
+/* Does the node match a substring pattern?  Without a slash, that means
+   its name contains the pattern.  With one, the pattern must occur in
+   the node's pathname and end inside the node's own name, so that
+   "proj/foo" finds the foo directory rather than everything in it. */
+bool
+search_match_node (node_s *node, const char *pattern)
+{
+	char path[PATH_MAX];
+	long len, namelen, plen;
+	const char *p;
+
+	if (!strchr(pattern, '/'))
+		return strstr(node->name, pattern) != NULL;
+
+	len = node_path(node, path, sizeof(path));
+	if (len >= sizeof(path)) return 0;
+	namelen = strlen(node->name);
+	plen = strlen(pattern);
+	for (p = path; (p = strstr(p, pattern)); ++p)
+		if ((p - path) + plen > len - namelen)
+			return 1;
+	return 0;
+}
+
+/* Find the longest run of characters that any match of an extended
+   regular expression has to contain, being careful to give up rather
+   than guess wrong.  Returns its length. */
+static int
+regex_literal (const char *re, char *buf, int size)
+{
+	char run[PATH_MAX];
+	int runlen = 0, best = 0;
+	const char *p;
+
+	*buf = '\0';
+	if (strpbrk(re, "|()")) return 0;
+
+	for (p = re; ; ++p) {
+		bool end_run = 0;
+		switch (*p) {
+		case '\0':
+		case '.': case '^': case '$': case '+':
+			end_run = 1;
+			break;
+		case '*': case '?':
+			if (runlen) --runlen; /* previous char is optional */
+			end_run = 1;
+			break;
+		case '{':
+			if (runlen) --runlen;
+			while (p[1] && *p != '}') ++p;
+			end_run = 1;
+			break;
+		case '[':
+			/* a ] first is part of the list, and [:class:],
+			   [=x=] and [.x.] have their own */
+			++p;
+			if (*p == '^') ++p;
+			if (*p == ']') ++p;
+			while (*p && *p != ']') {
+				if (*p == '[' && p[1] && strchr(":=.", p[1])) {
+					char close = p[1];
+					for (p += 2; *p && !(*p == close
+							     && p[1] == ']'); ++p)
+						;
+					if (!*p) return 0;
+					++p;
+				}
+				++p;
+			}
+			if (!*p) return 0;
+			end_run = 1;
+			break;
+		case '\\':
+			if (p[1] && strchr(".[]()*+?{}|^$\\/", p[1])) {
+				++p;
+				if (runlen < sizeof(run) - 1) run[runlen++] = *p;
+			}
+			else {
+				if (p[1]) ++p;
+				end_run = 1;
+			}
+			break;
+		default:
+			if (runlen < sizeof(run) - 1) run[runlen++] = *p;
+			break;
+		}
+		if (end_run) {
+			if (runlen > best && runlen < size) {
+				memcpy(buf, run, runlen);
+				buf[runlen] = '\0';
+				best = runlen;
+			}
+			runlen = 0;
+		}
+		if (!*p) break;
+	}
+	return best;
+}
+
+/* Find nodes matching a pattern, which is a substring or, if is_regex
+   is set, a POSIX extended regular expression.  Either kind is matched
+   against the pathname when it contains a slash and against the name
+   otherwise.  Stores the ids of the matching nodes, in ascending order,
+   in *results.  Returns how many, or -1 if the regex is invalid. */
+long
+search_find (const char *pattern, bool is_regex, long **results)
+{
+	results_s r = { NULL, 0, 0 };
+	search_index_s *index = search_index_get();
+	char copy[PATH_MAX];
+	char literal[PATH_MAX];
+	regex_t re;
+	long i, n;
+
+	if (!is_regex) {
+		char *last;
+		long *candidates;
+
+		snprintf(copy, sizeof(copy), "%s", pattern);
+		for (i = strlen(copy); i > 1 && copy[i - 1] == '/'; --i)
+			copy[i - 1] = '\0';
+		last = strrchr(copy, '/');
+		last = last ? last + 1 : copy;
+
+		/* whatever matches must have a name containing the part
+		   after the last slash */
+		n = search_candidates(last, &candidates);
+		if (last == copy) {
+			*results = candidates;
+			return n;
+		}
+		for (i = 0; i < n; ++i)
+			if (search_match_node(node_table[candidates[i]], copy))
+				results_add(&r, candidates[i]);
+		free(candidates);
+		*results = r.ids;
+		return r.n;
+	}
+
+	if (regcomp(&re, pattern, REG_EXTENDED | (strchr(pattern, '/')
+						  ? 0 : REG_NOSUB)))
+		return -1;
+
+	if (!strchr(pattern, '/')) {
+		regex_literal(pattern, literal, sizeof(literal));
+		search_each_name(index, literal, add_if_regex, &re, &r);
+		qsort(r.ids, r.n, sizeof(long), long_cmp);
+	}
+	else {
+		/* no index for this; check every pathname */
+		regmatch_t match;
+		for (i = 0; i < index->nnodes; ++i) {
+			node_s *node = node_table[i];
+			long len;
+			if (!(node && node->parent)) continue;
+			len = node_path(node, copy, sizeof(copy));
+			if (len < sizeof(copy)
+			    && !regexec(&re, copy, 1, &match, 0)
+			    && match.rm_eo > len - (long)strlen(node->name))
+				results_add(&r, i);
+		}
+	}
+	regfree(&re);
+	*results = r.ids;
+	return r.n;
+}
@@ -0,0 +1,41 @@
+/*
+ * search.h
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#ifndef SEARCH_H
+#define SEARCH_H
+/*****************************************************************************/
+
+#include "tdu.h"
+#include "node.h"
+
+/* Trigrams are hashed down to this many bits to pick a posting list.
+   Collisions only cost extra candidates, which are verified anyway. */
+#define TRIGRAM_BITS 20
+
+void search_index_start (void);
+void search_index_wait (void);
+void search_index_invalidate (void);
+long search_candidates (const char *literal, long **results);
+long search_find (const char *pattern, bool is_regex, long **results);
+bool search_match_node (node_s *node, const char *pattern);
+
+/*****************************************************************************/
+#endif /* SEARCH_H */
@@ -0,0 +1,382 @@
+/*
+ * server.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "server.h"
+#include "update.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/* There is one copy of the tree, and the expanded counts in its nodes
+   belong to whichever client last made a request.  Before another
+   client's request is handled, the owner's expanded directories are
+   written down (by id, parents first) and the tree is collapsed and
+   re-expanded to the new client's list.  That costs time in proportion
+   to the number of lines the two clients have open, not the size of
+   the tree. */
+
+typedef struct client {
+	int fd;
+	FILE *out;
+	char buf[SERVER_LINE_MAX];
+	int len;
+	long *expanded;		/* ids, saved while someone else owns */
+	long nexpanded;
+} client_s;
+
+static node_s *tree_root;	/* [root] */
+static node_s *view_root;	/* line 0 */
+static client_s *clients[SERVER_MAX_CLIENTS];
+static int nclients = 0;
+static client_s *owner = NULL;
+static const char *socket_path = NULL;
+
+static void
+server_finish (int sig)
+{
+	if (socket_path) unlink(socket_path);
+	exit(0);
+}
+
+/* Give the tree's expanded state to a client. */
+static void
+server_switch_to (client_s *c)
+{
+	if (owner == c) return;
+	if (owner) {
+		free(owner->expanded);
+		owner->nexpanded = tree_save_expanded(view_root,
+						      &owner->expanded);
+	}
+	collapse_tree(view_root);
+	tree_restore_expanded(c->expanded, c->nexpanded);
+	owner = c;
+}
+
+static void
+server_write_name (FILE *out, const char *s)
+{
+	for (; *s; ++s) {
+		if (*s == '\t') fputs("\\t", out);
+		else if (*s == '\n') fputs("\\n", out);
+		else if (*s == '\\') fputs("\\\\", out);
+		else putc(*s, out);
+	}
+}
+
+static void
+server_rows (client_s *c, long start, long count)
+{
+	char branches[PATH_MAX];
+	long total = view_root->expanded + 1;
+	long line;
+	int depth, i;
+
+	fprintf(c->out, "TOTAL %ld\n", total);
+	for (line = start; line >= 0 && line < start + count && line < total;
+	     ++line) {
+		node_s *node = find_node_numbered(view_root, line);
+		node_s *p;
+		if (!node) break;
+
+		depth = 0;
+		for (p = node; p != view_root && p->parent
+			     && depth < sizeof(branches) - 1; p = p->parent)
+			++depth;
+		branches[depth] = '\0';
+		for (i = depth - 1, p = node; i >= 0; --i, p = p->parent)
+			branches[i] = p->is_last_child ? 'L' : 'N';
+
+		fprintf(c->out, "R\t%ld\t%ld\t%s\t%d\t", node->size,
+			node->descendents, branches,
+			((node->nchildren || node_has_unloaded_children(node))
+			 && !node->expanded));
+		server_write_name(c->out, node->name ? node->name : "");
+		putc('\n', c->out);
+	}
+	fputs("END\n", c->out);
+}
+
+/* Apply newer du output on behalf of the tree's owner.  Everyone
+   else's expanded directories are kept by id, so the ones that are
+   still there come back when they next switch in. */
+static long
+server_update (const char *file)
+{
+	node_s *view = view_root;
+	long *expanded;
+	long nexpanded, changed, view_id = view_root->id;
+
+	nexpanded = tree_save_expanded(tree_root, &expanded);
+	collapse_tree(tree_root);
+	changed = update_tree(tree_root, file);
+	tree_restore_expanded(expanded, nexpanded);
+	free(expanded);
+
+	/* the top directory itself may have gone, and view_root with it */
+	if (view_id < 0 || node_table[view_id] != view) {
+		view_root = (tree_root->nchildren == 1)
+			? tree_root->children[0] : tree_root;
+		if (!view_root->expanded) expand_tree(view_root, 1);
+	}
+	return changed;
+}
+
+/* Handle one request.  Returns 0 if the client is done. */
+static int
+server_request (client_s *c, char *line)
+{
+	char cmd[16];
+	long a = 0, b = 0;
+	int rev = 0, rec = 0;
+	char key = 0;
+	node_s *node;
+
+	if (sscanf(line, "%15s", cmd) != 1) {
+		fputs("ERR empty request\n", c->out);
+		return 1;
+	}
+	if (!strcmp(cmd, "QUIT")) return 0;
+
+	server_switch_to(c);
+
+	if (!strcmp(cmd, "ROWS") && sscanf(line, "%*s %ld %ld", &a, &b) == 2) {
+		server_rows(c, a, b);
+		return 1;
+	}
+	if (!strcmp(cmd, "EXPAND")
+	    && sscanf(line, "%*s %ld %ld", &a, &b) == 2) {
+		node = find_node_numbered(view_root, a);
+		fprintf(c->out, "OK %ld\n", node ? expand_tree(node, b) : 0L);
+		return 1;
+	}
+	if (!strcmp(cmd, "COLLAPSE") && sscanf(line, "%*s %ld", &a) == 1) {
+		node = find_node_numbered(view_root, a);
+		fprintf(c->out, "OK %ld\n", node ? collapse_tree(node) : 0L);
+		return 1;
+	}
+	if (!strcmp(cmd, "PARENT") && sscanf(line, "%*s %ld", &a) == 1) {
+		node = find_node_numbered(view_root, a);
+		fprintf(c->out, "OK %ld\n",
+			(node && node != view_root)
+			? find_node_number_in(node->parent, view_root) : -1L);
+		return 1;
+	}
+	if (!strcmp(cmd, "SORT")
+	    && sscanf(line, "%*s %ld %c %d %d", &a, &key, &rev, &rec) == 4) {
+		node_sort_fp fp = (key == 's') ? node_cmp_size
+			: (key == 'n') ? node_cmp_name
+			: (key == 'd') ? node_cmp_descendents
+			: node_cmp_unsort;
+		node = find_node_numbered(view_root, a);
+		if (node && node->expanded)
+			tree_sort(node, fp, rev, rec);
+		fputs("OK 0\n", c->out);
+		return 1;
+	}
+	if (!strcmp(cmd, "UPDATE") && line[6] == ' ') {
+		long changed = server_update(line + 7);
+		if (changed < 0)
+			fprintf(c->out, "ERR %s: %s\n", line + 7,
+				strerror(errno));
+		else
+			fprintf(c->out, "OK %ld\n", changed);
+		return 1;
+	}
+	fputs("ERR bad request\n", c->out);
+	return 1;
+}
+
+static void
+server_drop (int i)
+{
+	client_s *c = clients[i];
+
+	if (owner == c) owner = NULL;
+	fclose(c->out);
+	close(c->fd);
+	free(c->expanded);
+	free(c);
+	clients[i] = clients[--nclients];
+}
+
+static void
+server_accept (int listener)
+{
+	client_s *c;
+	int fd = accept(listener, NULL, NULL);
+
+	if (fd < 0) return;
+	if (nclients == SERVER_MAX_CLIENTS) {
+		close(fd);
+		return;
+	}
+	c = malloc(sizeof(client_s));
+	if (!c || !(c->expanded = malloc(sizeof(long)))) {
+		perror("server_accept: malloc");
+		exit(1);
+	}
+	c->fd = fd;
+	if (!(c->out = fdopen(dup(fd), "w"))) {
+		perror("server_accept: fdopen");
+		exit(1);
+	}
+	c->len = 0;
+	c->expanded[0] = view_root->id; /* start out one level deep */
+	c->nexpanded = 1;
+	clients[nclients++] = c;
+}
+
+/* Read what a client has sent and handle any whole requests.  Returns
+   0 if the client has gone away. */
+static int
+server_read (client_s *c)
+{
+	char *nl;
+	ssize_t n;
+	int ok = 1;
+
+	n = read(c->fd, c->buf + c->len, sizeof(c->buf) - 1 - c->len);
+	if (n <= 0) return 0;
+	c->len += n;
+	c->buf[c->len] = '\0';
+
+	while (ok && (nl = strchr(c->buf, '\n'))) {
+		*nl = '\0';
+		ok = server_request(c, c->buf);
+		c->len -= nl + 1 - c->buf;
+		memmove(c->buf, nl + 1, c->len + 1);
+	}
+	if (c->len == sizeof(c->buf) - 1) {
+		fputs("ERR request too long\n", c->out);
+		c->len = 0;
+	}
+	fflush(c->out);
+	return ok && !ferror(c->out);
+}
+
+static int
+server_listen (const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "tdu: %s: socket path too long\n", path);
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		perror("tdu: socket");
+		return -1;
+	}
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		if (errno != EADDRINUSE) {
+			fprintf(stderr, "tdu: %s: %s\n", path, strerror(errno));
+			close(fd);
+			return -1;
+		}
+		/* is it still being served? */
+		if (!connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+			fprintf(stderr, "tdu: %s: already served\n", path);
+			close(fd);
+			return -1;
+		}
+		if (errno != ECONNREFUSED) {
+			fprintf(stderr, "tdu: %s: %s\n", path, strerror(errno));
+			close(fd);
+			return -1;
+		}
+		/* left over from a server that's gone */
+		close(fd);
+		unlink(path);
+		if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+			perror("tdu: socket");
+			return -1;
+		}
+		if (bind(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+			fprintf(stderr, "tdu: %s: %s\n", path, strerror(errno));
+			close(fd);
+			return -1;
+		}
+	}
+	if (listen(fd, 16)) {
+		fprintf(stderr, "tdu: %s: %s\n", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* Serve a tree to clients connecting to a socket at path, until
+   killed.  Returns an exit status if it can't. */
+int
+server_run (node_s *root, const char *path)
+{
+	struct pollfd fds[SERVER_MAX_CLIENTS + 1];
+	int listener;
+	int i;
+
+	tree_root = root;
+	view_root = (root->nchildren == 1) ? root->children[0] : root;
+
+	if ((listener = server_listen(path)) < 0)
+		return 1;
+	socket_path = path;
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT,  server_finish);
+	signal(SIGTERM, server_finish);
+	signal(SIGHUP,  server_finish);
+
+	while (1) {
+		fds[0].fd = listener;
+		fds[0].events = POLLIN;
+		for (i = 0; i < nclients; ++i) {
+			fds[i + 1].fd = clients[i]->fd;
+			fds[i + 1].events = POLLIN;
+		}
+		if (poll(fds, nclients + 1, -1) < 0) {
+			if (errno == EINTR) continue;
+			perror("server_run: poll");
+			server_finish(0);
+		}
+		/* backwards, since dropping a client moves the last one
+		   into its place */
+		for (i = nclients - 1; i >= 0; --i)
+			if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))
+				if (!server_read(clients[i]))
+					server_drop(i);
+		if (fds[0].revents & POLLIN)
+			server_accept(listener);
+	}
+}
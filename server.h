@@ -0,0 +1,58 @@
+/*
+ * server.h
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+/*****************************************************************************/
+
+#include "tdu.h"
+#include "node.h"
+
+/* The protocol between tdu --serve and tdu --attach is a line of text
+   each way, over a Unix-domain stream socket.  Line numbers are the
+   same as in the interface (see find_node_numbered()), and each client
+   has its own set of expanded directories.
+
+     ROWS start count       TOTAL lines, then up to count lines of
+                            R <tab> size <tab> descendents <tab> branches
+                              <tab> more <tab> name
+                            then END.  branches has one character per
+                            level, L for a last child and N for any
+                            other; more is 1 if there are hidden
+                            children.  Tabs, newlines and backslashes
+                            in names are escaped as \t, \n and \\.
+     EXPAND line levels     OK lines-added   (levels -1 is all)
+     COLLAPSE line          OK lines-removed
+     SORT line key rev rec  OK 0             (key is s, n, d or u)
+     PARENT line            OK parent's-line (-1 if none)
+     UPDATE file            OK entries-changed, after applying newer
+                            du output from a file the server can read
+     QUIT
+
+   Anything else gets ERR and a message. */
+
+#define SERVER_LINE_MAX 256	/* longest request */
+#define SERVER_MAX_CLIENTS 64
+
+int server_run (node_s *root, const char *path);
+
+/*****************************************************************************/
+#endif /* SERVER_H */
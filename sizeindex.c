@@ -0,0 +1,186 @@
+/*
+ * sizeindex.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "sizeindex.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The size index lists every file (node without children) and every
+   directory in the tree in order of decreasing size, with the sizes
+   copied alongside the ids so that searching the lists doesn't have to
+   touch the nodes.  It is built the first time it is needed, once the
+   tree's sizes are final, and thrown away if the tree changes. */
+
+typedef struct size_entry {
+	TDU_SIZE_T size;
+	long id;
+} size_entry_s;
+
+typedef struct size_list {
+	size_entry_s *entries;
+	long n;
+} size_list_s;
+
+static bool size_index_built = 0;
+static size_list_s size_files = { NULL, 0 };
+static size_list_s size_dirs = { NULL, 0 };
+
+static int
+size_entry_cmp (const void *aa, const void *bb)
+{
+	const size_entry_s *a = aa;
+	const size_entry_s *b = bb;
+	if (a->size != b->size) return (a->size < b->size) ? 1 : -1;
+	return (a->id > b->id) - (a->id < b->id);
+}
+
+/* A directory may have nothing in memory yet (see lazy.c, spill.c and
+   bfs.c), but it isn't one of the files for that. */
+static bool
+size_is_dir (node_s *node)
+{
+	return node->nchildren || node_has_unloaded_children(node);
+}
+
+static void
+size_index_build ()
+{
+	long i, nfiles = 0, ndirs = 0;
+
+	for (i = 0; i < node_table_size; ++i) {
+		node_s *node = node_table[i];
+		if (!(node && node->parent)) continue;
+		if (size_is_dir(node)) ++ndirs; else ++nfiles;
+	}
+	size_files.entries = malloc((nfiles ? nfiles : 1)
+				    * sizeof(size_entry_s));
+	size_dirs.entries = malloc((ndirs ? ndirs : 1)
+				   * sizeof(size_entry_s));
+	if (!size_files.entries || !size_dirs.entries) {
+		perror("size_index_build: malloc");
+		exit(1);
+	}
+	size_files.n = size_dirs.n = 0;
+	for (i = 0; i < node_table_size; ++i) {
+		node_s *node = node_table[i];
+		size_list_s *list;
+		if (!(node && node->parent)) continue;
+		list = size_is_dir(node) ? &size_dirs : &size_files;
+		list->entries[list->n].size = node->size;
+		list->entries[list->n].id = i;
+		++list->n;
+	}
+	qsort(size_files.entries, size_files.n, sizeof(size_entry_s),
+	      size_entry_cmp);
+	qsort(size_dirs.entries, size_dirs.n, sizeof(size_entry_s),
+	      size_entry_cmp);
+	size_index_built = 1;
+}
+
+/* Throw the index away; it will be rebuilt the next time it's needed. */
+void
+size_index_invalidate ()
+{
+	free(size_files.entries);
+	free(size_dirs.entries);
+	size_files.entries = size_dirs.entries = NULL;
+	size_files.n = size_dirs.n = 0;
+	size_index_built = 0;
+}
+
+/* Index of the first entry in a list no bigger than size. */
+static long
+size_list_find (size_list_s *list, TDU_SIZE_T size)
+{
+	long lo = 0, hi = list->n;
+	while (lo < hi) {
+		long mid = (lo + hi) / 2;
+		if (list->entries[mid].size > size) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+/* Merge entries a[0..na) and b[0..nb), both in decreasing order of size,
+   into a list of at most max ids.  Returns how many. */
+static long
+size_merge (size_entry_s *a, long na, size_entry_s *b, long nb, long max,
+	    long **results)
+{
+	long n = 0;
+	long *ids;
+
+	if (max > na + nb) max = na + nb;
+	ids = malloc((max ? max : 1) * sizeof(long));
+	if (!ids) {
+		perror("size_merge: malloc");
+		exit(1);
+	}
+	while (n < max) {
+		if (nb == 0 || (na && a->size >= b->size)) {
+			ids[n++] = a->id; ++a; --na;
+		}
+		else {
+			ids[n++] = b->id; ++b; --nb;
+		}
+	}
+	*results = ids;
+	return n;
+}
+
+/* The ids of the n largest files, directories, or both.  Returns how
+   many were found. */
+long
+size_index_top (int which, long n, long **results)
+{
+	if (!size_index_built) size_index_build();
+	return size_merge(size_files.entries,
+			  (which & SIZE_INDEX_FILES) ? size_files.n : 0,
+			  size_dirs.entries,
+			  (which & SIZE_INDEX_DIRS) ? size_dirs.n : 0,
+			  n, results);
+}
+
+/* The ids of the files, directories, or both whose sizes are between min
+   and max inclusive, largest first.  Returns how many were found. */
+long
+size_index_range (int which, TDU_SIZE_T min, TDU_SIZE_T max, long **results)
+{
+	long fstart, fend, dstart, dend;
+
+	if (!size_index_built) size_index_build();
+	if (min > max) {
+		*results = NULL;
+		return 0;
+	}
+	fstart = size_list_find(&size_files, max);
+	fend = min ? size_list_find(&size_files, min - 1) : size_files.n;
+	dstart = size_list_find(&size_dirs, max);
+	dend = min ? size_list_find(&size_dirs, min - 1) : size_dirs.n;
+	if (!(which & SIZE_INDEX_FILES)) fend = fstart;
+	if (!(which & SIZE_INDEX_DIRS)) dend = dstart;
+	return size_merge(size_files.entries + fstart, fend - fstart,
+			  size_dirs.entries + dstart, dend - dstart,
+			  (fend - fstart) + (dend - dstart), results);
+}
@@ -0,0 +1,194 @@
+/*
+ * sketch.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "sketch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Each directory's sketch is a histogram of the sizes of the files
+   under it, made when its size and descendents are worked out from its
+   children's, by adding up its children's sketches and the sizes of
+   the files in it.  Anything with nothing in it counts as a file.
+
+   A sketch is kept by node id, away from the nodes as metrics are, and
+   packed as varints: for each bucket with anything in it, how far it
+   is past the last one, how many files it has and their total size, in
+   the same units as the sizes.  Few directories have files in more
+   than a dozen or so buckets, so that's a few dozen bytes rather than
+   a kilobyte apiece. */
+
+typedef struct packed {
+	unsigned char *bytes;	/* NULL if the directory has no sketch */
+	int len;
+} packed_s;
+
+static packed_s *sketches = NULL;	/* by id */
+static long sketches_size = 0;
+
+int
+sketch_bucket (TDU_SIZE_T size)
+{
+	unsigned long long bytes = (unsigned long long)size * tdu_block_size;
+	int b = 0;
+
+	while (bytes) {
+		++b;
+		bytes >>= 1;
+	}
+	return (b < SKETCH_BUCKETS) ? b : SKETCH_BUCKETS - 1;
+}
+
+static packed_s *
+sketch_packed (const node_s *node)
+{
+	if (node->id < 0 || node->id >= sketches_size) return NULL;
+	return sketches[node->id].bytes ? &sketches[node->id] : NULL;
+}
+
+static void
+sketch_store (node_s *node, const sketch_s *sketch)
+{
+	unsigned char buf[(SKETCH_BUCKETS + 1) * 3 * VARINT_MAX];
+	int b, last = 0, len = 0;
+
+	if (node->id >= sketches_size) {
+		long n = sketches_size ? sketches_size : 1024;
+		while (n <= node->id) n *= 2;
+		sketches = realloc(sketches, n * sizeof(packed_s));
+		if (!sketches) {
+			perror("sketch_store: realloc");
+			exit(1);
+		}
+		memset(sketches + sketches_size, 0,
+		       (n - sketches_size) * sizeof(packed_s));
+		sketches_size = n;
+	}
+	for (b = 0; b <= SKETCH_BUCKETS; ++b) {
+		if (!sketch->files[b]) continue;
+		len += varint_put(buf + len, b - last);
+		len += varint_put(buf + len, sketch->files[b]);
+		len += varint_put(buf + len, sketch->size[b]);
+		last = b;
+	}
+	free(sketches[node->id].bytes);
+	/* an empty sketch still needs a byte to say it's there */
+	if (!(sketches[node->id].bytes = malloc(len ? len : 1))) {
+		perror("sketch_store: malloc");
+		exit(1);
+	}
+	memcpy(sketches[node->id].bytes, buf, len);
+	sketches[node->id].len = len;
+}
+
+static void
+sketch_add_packed (sketch_s *sketch, const packed_s *packed)
+{
+	const unsigned char *p = packed->bytes;
+	const unsigned char *end = p + packed->len;
+	int b = 0;
+
+	while (p < end) {
+		b += varint_get(&p);
+		sketch->files[b] += varint_get(&p);
+		sketch->size[b] += varint_get(&p);
+	}
+}
+
+/* Add a child of a directory being sketched. */
+static void
+sketch_add (sketch_s *sketch, node_s *node)
+{
+	packed_s *packed = sketch_packed(node);
+
+	if (node->nchildren) {
+		if (!packed) {
+			sketch_merge(node);
+			packed = sketch_packed(node);
+		}
+	}
+	else if (!node_has_unloaded_children(node)) {
+		sketch->files[sketch_bucket(node->size)] += 1;
+		sketch->size[sketch_bucket(node->size)] += node->size;
+		return;
+	}
+	if (packed) {
+		sketch_add_packed(sketch, packed);
+	}
+	else {
+		/* not read yet, and never read before being put away */
+		sketch->files[SKETCH_UNREAD] += 1;
+		sketch->size[SKETCH_UNREAD] += node->size;
+	}
+}
+
+/* Make a directory's sketch from its children's. */
+void
+sketch_merge (node_s *node)
+{
+	sketch_s sketch;
+	long i;
+
+	if (node->id < 0 || !node->nchildren) return;
+	memset(&sketch, 0, sizeof(sketch));
+	for (i = 0; i < node->nchildren; ++i)
+		sketch_add(&sketch, node->children[i]);
+	sketch_store(node, &sketch);
+}
+
+/* Make the sketches of a directory and everything above it again,
+   after something in it has changed. */
+void
+sketch_merge_up (node_s *node)
+{
+	for (; node; node = node->parent)
+		sketch_merge(node);
+}
+
+/* A node is about to be freed: drop the sketches under it. */
+void
+sketch_forget (node_s *node)
+{
+	packed_s *packed = sketch_packed(node);
+	long i;
+
+	if (packed) {
+		free(packed->bytes);
+		packed->bytes = NULL;
+	}
+	for (i = 0; i < node->nchildren; ++i)
+		sketch_forget(node->children[i]);
+}
+
+/* The sizes of the files at or under node. */
+void
+sketch_get (node_s *node, sketch_s *sketch)
+{
+	/* a filtered view shares ids with the tree it's a view of */
+	if (node->id >= 0 && node->id < node_table_size
+	    && node_table[node->id])
+		node = node_table[node->id];
+
+	memset(sketch, 0, sizeof(*sketch));
+	sketch_add(sketch, node);
+}
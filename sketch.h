@@ -0,0 +1,47 @@
+/*
+ * sketch.h
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#ifndef SKETCH_H
+#define SKETCH_H
+/*****************************************************************************/
+
+#include "tdu.h"
+#include "node.h"
+
+/* files are bucketed by the bit length of their size in bytes, so that
+   bucket b > 0 holds sizes from 2^(b-1) up to 2^b - 1 */
+#define SKETCH_BUCKETS 64
+/* and one more bucket totals the directories not read yet */
+#define SKETCH_UNREAD SKETCH_BUCKETS
+
+typedef struct sketch {
+	long files[SKETCH_BUCKETS + 1];
+	TDU_SIZE_T size[SKETCH_BUCKETS + 1];
+} sketch_s;
+
+int sketch_bucket (TDU_SIZE_T size);
+void sketch_merge (node_s *node);
+void sketch_merge_up (node_s *node);
+void sketch_forget (node_s *node);
+void sketch_get (node_s *node, sketch_s *sketch);
+
+/*****************************************************************************/
+#endif /* SKETCH_H */
@@ -0,0 +1,152 @@
+/*
+ * slice.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "spill.h"
+#include "lazy.h"
+#include "slice.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/* A pass over many nodes, such as grouping files by extension (see
+   group.c) or matching a filter expression (see expr.c), is made over
+   an array of their ids, which is cut into slices, a thread to a
+   slice.  Each thread only reads the tree and writes its own slice.
+
+   Gathering the ids reads in whatever under root was written out (see
+   spill.c), past any --memory-limit, since each id has to stay good
+   until the pass is over; it's written out again, like anything else
+   collapsed, the next time a directory is expanded. */
+
+static int
+id_cmp (const void *a, const void *b)
+{
+	long x = *(const long *)a;
+	long y = *(const long *)b;
+	return (x > y) - (x < y);
+}
+
+/* The ids of the nodes at or under root that want() says to take, in
+   ascending order.  Returns how many; the caller frees *ids.  For the
+   top of the tree that's every node there is, which needs no walk. */
+long
+slice_ids (node_s *root, bool (*want) (const node_s *node), long **ids)
+{
+	node_s **stack;
+	long n = 0, nstack = 0, i;
+	long nalloc = node_table_size + 1, stackalloc = node_table_size + 1;
+
+	*ids = malloc(nalloc * sizeof(long));
+	if (!*ids) {
+		perror("slice_ids: malloc");
+		exit(1);
+	}
+	if (!tdu_memory_limit && !lazy_depth && root->id >= 0
+	    && node_table[root->id] == root
+	    && (!root->parent
+		|| (!root->parent->parent && root->parent->nchildren == 1))) {
+		for (i = 0; i < node_table_size; ++i)
+			if (node_table[i] && node_table[i]->parent
+			    && want(node_table[i]))
+				(*ids)[n++] = i;
+		return n;
+	}
+
+	stack = malloc(stackalloc * sizeof(node_s *));
+	if (!stack) {
+		perror("slice_ids: malloc");
+		exit(1);
+	}
+	stack[nstack++] = root;
+	while (nstack) {
+		node_s *node = stack[--nstack];
+		/* loading the children can add nodes to the table */
+		node_load_children(node);
+		if (n == nalloc) {
+			nalloc *= 2;
+			if (!(*ids = realloc(*ids, nalloc * sizeof(long)))) {
+				perror("slice_ids: realloc");
+				exit(1);
+			}
+		}
+		if (node->id >= 0 && node->parent && want(node))
+			(*ids)[n++] = node->id;
+		if (nstack + node->nchildren > stackalloc) {
+			stackalloc = 2 * (nstack + node->nchildren);
+			stack = realloc(stack, stackalloc * sizeof(node_s *));
+			if (!stack) {
+				perror("slice_ids: realloc");
+				exit(1);
+			}
+		}
+		for (i = 0; i < node->nchildren; ++i)
+			stack[nstack++] = node->children[i];
+	}
+	free(stack);
+	qsort(*ids, n, sizeof(long), id_cmp);
+	return n;
+}
+
+static void *
+slice_thread (void *data)
+{
+	slice_s *slice = data;
+	slice->fn(slice);
+	return NULL;
+}
+
+/* Call fn on slices of the n ids, each in a thread of its own, and
+   wait for them all.  Each slice starts out with arg and no results.
+   Returns how many slices there were, in order in slices[]. */
+int
+slice_run (long *ids, long n, void (*fn) (slice_s *slice), void *arg,
+	   slice_s slices[SLICE_MAX_THREADS])
+{
+	pthread_t threads[SLICE_MAX_THREADS];
+	int nthreads, t;
+
+	nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads > n / SLICE_MIN) nthreads = n / SLICE_MIN;
+	if (nthreads > SLICE_MAX_THREADS) nthreads = SLICE_MAX_THREADS;
+	if (nthreads < 1) nthreads = 1;
+
+	for (t = 0; t < nthreads; ++t) {
+		slices[t].fn = fn;
+		slices[t].arg = arg;
+		slices[t].ids = ids + n * t / nthreads;
+		slices[t].n = n * (t + 1) / nthreads - n * t / nthreads;
+		slices[t].results = NULL;
+		slices[t].nresults = 0;
+	}
+	for (t = 1; t < nthreads; ++t)
+		if (pthread_create(&threads[t], NULL, slice_thread,
+				   &slices[t])) {
+			perror("slice_run: pthread_create");
+			exit(1);
+		}
+	slice_thread(&slices[0]);
+	for (t = 1; t < nthreads; ++t)
+		pthread_join(threads[t], NULL);
+	return nthreads;
+}
@@ -0,0 +1,48 @@
+/*
+ * slice.h
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#ifndef SLICE_H
+#define SLICE_H
+/*****************************************************************************/
+
+#include "tdu.h"
+#include "node.h"
+
+/* at most this many threads share a slice_run() pass */
+#define SLICE_MAX_THREADS 8
+/* and each gets at least this many entries */
+#define SLICE_MIN 16384
+
+typedef struct slice {
+	void (*fn) (struct slice *slice);
+	void *arg;		/* the same for every slice */
+	long *ids;
+	long n;
+	void *results;		/* the slice's own, for fn to fill in */
+	long nresults;
+} slice_s;
+
+long slice_ids (node_s *root, bool (*want) (const node_s *node), long **ids);
+int slice_run (long *ids, long n, void (*fn) (slice_s *slice), void *arg,
+	       slice_s slices[SLICE_MAX_THREADS]);
+
+/*****************************************************************************/
+#endif /* SLICE_H */
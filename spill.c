@@ -0,0 +1,249 @@
+/*
+ * spill.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "spill.h"
+#include "search.h"
+#include "sizeindex.h"
+#include "filter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <glib.h>
+
+/* With a memory limit, a directory's children (and everything under
+   them) can be written out to an unlinked temporary file and freed,
+   leaving the directory itself with its size and descendent count.
+   Such a directory has no children but a nonzero number of
+   descendents; expanding it reads them back in, with the same ids, so
+   anything kept by id (metrics, history, saved expanded state) still
+   applies to them.  A subtree written out can hold directories that
+   were already written out themselves; they stay out when it's read
+   back.
+
+   While the tree is read, du's output lists each directory after
+   everything in it, so a directory whose line has been read is
+   complete and can be written out as soon as the tree is over the
+   limit.  Afterwards, directories read back in are written out again,
+   oldest first, once they are collapsed and the tree is over the limit.
+
+   Entries that are written out can't be searched for or listed by the
+   size and extension lists until they have been read back in. */
+
+TDU_SIZE_T tdu_memory_limit = 0;
+
+/* A directory is written out as the number of its children followed
+   by each of them: a record, its name, and then, in turn, each of its
+   own children. */
+typedef struct spill_record {
+	long id;
+	long size;
+	long descendents;
+	long nchildren;
+	int origindex;
+	int namelen;
+} spill_record_s;
+
+static FILE *spill_file = NULL;
+static GHashTable *spill_offsets = NULL; /* id -> 1 + offset of children */
+
+/* directories read back in, oldest first, by id */
+static long *loaded = NULL;
+static long nloaded = 0;
+static long loaded_alloc = 0;
+
+static void
+spill_open ()
+{
+	const char *dir = getenv("TMPDIR");
+	char *pathname;
+	int fd;
+
+	if (!dir || !*dir) dir = "/tmp";
+	pathname = malloc(strlen(dir) + sizeof("/tdu-spill-XXXXXX"));
+	if (!pathname) {
+		perror("spill_open: malloc");
+		exit(1);
+	}
+	sprintf(pathname, "%s/tdu-spill-XXXXXX", dir);
+	if ((fd = mkstemp(pathname)) < 0 || !(spill_file = fdopen(fd, "w+"))) {
+		perror(pathname);
+		exit(1);
+	}
+	unlink(pathname);
+	free(pathname);
+	spill_offsets = g_hash_table_new(g_direct_hash, g_direct_equal);
+}
+
+bool
+spill_is_spilled (const node_s *node)
+{
+	return (spill_offsets && node && !node->nchildren
+		&& node->descendents > 0 && node->id >= 0
+		&& node->id < node_table_size && node_table[node->id] == node
+		&& g_hash_table_lookup(spill_offsets, (gpointer)node->id));
+}
+
+static void
+spill_write (node_s *node)
+{
+	spill_record_s r;
+	long i;
+
+	r.id = node->id;
+	r.size = node->size;
+	r.descendents = node->descendents;
+	r.nchildren = node->nchildren;
+	r.origindex = node->origindex;
+	r.namelen = strlen(node->name);
+	if (fwrite(&r, sizeof(r), 1, spill_file) != 1
+	    || fwrite(node->name, 1, r.namelen, spill_file) != r.namelen) {
+		perror("spill_write: fwrite");
+		exit(1);
+	}
+	for (i = 0; i < node->nchildren; ++i)
+		spill_write(node->children[i]);
+}
+
+/* Nothing may hold on to nodes that are about to come or go. */
+static void
+spill_invalidate ()
+{
+	search_index_invalidate();
+	size_index_invalidate();
+	filter_reset();
+}
+
+/* Write a complete, collapsed directory's children out and free them. */
+void
+spill_node (node_s *node)
+{
+	off_t offset;
+	long i;
+
+	if (!node->nchildren || node->expanded || node->id < 0) return;
+	if (!spill_file) spill_open();
+	spill_invalidate();
+
+	fix_tree_descendents(node);
+	node_rollup_free(node);
+	fseeko(spill_file, 0, SEEK_END);
+	offset = ftello(spill_file);
+	if (fwrite(&node->nchildren, sizeof(long), 1, spill_file) != 1) {
+		perror("spill_node: fwrite");
+		exit(1);
+	}
+	for (i = 0; i < node->nchildren; ++i)
+		spill_write(node->children[i]);
+	g_hash_table_insert(spill_offsets, (gpointer)node->id,
+			    (gpointer)(long)(offset + 1));
+
+	for (i = 0; i < node->nchildren; ++i)
+		free_tree(node->children[i]);
+	if (node->children_by_name) {
+		g_hash_table_destroy(node->children_by_name);
+		node->children_by_name = NULL;
+	}
+	free(node->children);
+	node->children = NULL;
+	node->nchildren = 0;
+	node->nchildrenblocks = 0;
+}
+
+static void
+spill_read (node_s *parent, long nchildren)
+{
+	spill_record_s r;
+	char *name;
+	long i;
+
+	for (i = 0; i < nchildren; ++i) {
+		node_s *node;
+
+		if (fread(&r, sizeof(r), 1, spill_file) != 1
+		    || !(name = malloc(r.namelen + 1))
+		    || fread(name, 1, r.namelen, spill_file) != r.namelen) {
+			perror("spill_read: fread");
+			exit(1);
+		}
+		name[r.namelen] = '\0';
+		node = new_node_at(name, r.id);
+		free(name);
+		node->size = r.size;
+		node->descendents = r.descendents;
+		add_child(parent, node);
+		node->origindex = r.origindex;
+		spill_read(node, r.nchildren);
+	}
+}
+
+/* Read a directory's children back in. */
+void
+spill_load (node_s *node)
+{
+	long offset, nchildren;
+
+	if (!spill_is_spilled(node)) return;
+	spill_invalidate();
+
+	offset = (long)g_hash_table_lookup(spill_offsets, (gpointer)node->id);
+	g_hash_table_remove(spill_offsets, (gpointer)node->id);
+	fseeko(spill_file, offset - 1, SEEK_SET);
+	if (fread(&nchildren, sizeof(long), 1, spill_file) != 1) {
+		perror("spill_load: fread");
+		exit(1);
+	}
+	spill_read(node, nchildren);
+	cleanup_tree(node);
+
+	if (nloaded >= loaded_alloc) {
+		loaded_alloc = loaded_alloc ? loaded_alloc * 2 : KIDSATATIME;
+		loaded = realloc(loaded, loaded_alloc * sizeof(long));
+		if (!loaded) {
+			perror("spill_load: realloc");
+			exit(1);
+		}
+	}
+	loaded[nloaded++] = node->id;
+}
+
+/* While the tree is over the limit, write out the directories read
+   back in longest ago that are collapsed again. */
+void
+spill_trim ()
+{
+	long i, n;
+
+	if (!tdu_memory_limit) return;
+	for (i = n = 0; i < nloaded; ++i) {
+		node_s *node = node_table[loaded[i]];
+		if (!node || !node->nchildren)
+			continue;	/* gone, or written out with a parent */
+		if (node_memory > tdu_memory_limit && !node->expanded)
+			spill_node(node);
+		else
+			loaded[n++] = loaded[i];
+	}
+	nloaded = n;
+}
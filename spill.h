@@ -0,0 +1,38 @@
+/*
+ * spill.h
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#ifndef SPILL_H
+#define SPILL_H
+/*****************************************************************************/
+
+#include "tdu.h"
+#include "node.h"
+
+/* bytes the tree may take up before subtrees are written out, or 0 */
+extern TDU_SIZE_T tdu_memory_limit;
+
+bool spill_is_spilled (const node_s *node);
+void spill_node (node_s *node);
+void spill_load (node_s *node);
+void spill_trim (void);
+
+/*****************************************************************************/
+#endif /* SPILL_H */
@@ -22,13 +22,29 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <string.h>
+#include <errno.h>
 #include <getopt.h>
 
 #include "tdu.h"
 #include "node.h"
 #include "tduint.h"
+#include "search.h"
+#include "batch.h"
+#include "server.h"
+#include "attach.h"
+#include "metric.h"
+#include "history.h"
+#include "spill.h"
+#include "lazy.h"
+#include "replay.h"
+#include "export.h"
+#include "walk.h"
+#include "watch.h"
+#include "bfs.h"
+#include "perf.h"
 
-static char *optstring = "hG:I:AVP";
+static char *optstring = "hG:I:AVPB:R:M:H:t:L:p:m:f:w:";
 static char *progname = "tdu";
 
 struct option long_options[] = {
@@ -37,6 +53,26 @@ struct option long_options[] = {
 	{ "parse-only", 0, NULL, 'P' },
 	{ "version",    0, NULL, 'V' },
 	{ "debug",      0, NULL, 'd' },
+	{ "block-size", 1, NULL, 'B' },
+	{ "rollup",     1, NULL, 'R' },
+	{ "metric",     1, NULL, 'M' },
+	{ "history",    1, NULL, 'H' },
+	{ "top",        1, NULL, 't' },
+	{ "depth",      1, NULL, 'L' },
+	{ "path",       1, NULL, 'p' },
+	{ "min-size",   1, NULL, 'm' },
+	{ "format",     1, NULL, 'f' },
+	{ "where",      1, NULL, 'w' },
+	{ "serve",      1, NULL, 'S' },
+	{ "attach",     1, NULL, 'a' },
+	{ "memory-limit", 1, NULL, 'x' },
+	{ "lazy",       1, NULL, 'y' },
+	{ "replay",     1, NULL, 'r' },
+	{ "export-columns", 1, NULL, 'E' },
+	{ "scan",       1, NULL, 'D' },
+	{ "watch",      0, NULL, 'W' },
+	{ "progressive", 0, NULL, 'g' },
+	{ "natural-sort", 0, NULL, 'N' },
 	{ NULL,         0, NULL, 0 }
 };
 
@@ -44,7 +80,55 @@ struct option long_options[] = {
 	"usage: du [OPTION ...] [FILE ...] | %s [OPTION ...] [FILE ...]\n" \
 	"  -h, --help        display this message\n" \
 	"  -A, --ascii-tree  display tree branches using ASCII characters\n" \
-	"  -V, --version     show version, license terms\n"
+	"  -B, --block-size=SIZE\n" \
+	"                    bytes per unit of size in du's output (default 1K)\n" \
+	"  -R, --rollup=COUNT\n" \
+	"                    show at most COUNT entries of a directory at a time,\n" \
+	"                    the largest, and roll up the rest (default 1000;\n" \
+	"                    0 shows all)\n" \
+	"  --natural-sort    sort numbers in names by value, so that file2 comes\n" \
+	"                    before file10\n" \
+	"  -M, --metric=NAME=FILE\n" \
+	"                    add a column NAME from another du run over the same\n" \
+	"                    tree, such as du -ab or du --inodes\n" \
+	"  -H, --history=FILE\n" \
+	"                    an earlier du run over the same tree, dated by a\n" \
+	"                    YYYY-MM-DD in its name or else its mtime; with any,\n" \
+	"                    show each entry's growth over the last 7 or 30 days\n" \
+	"  --memory-limit=SIZE\n" \
+	"                    keep the tree within about SIZE bytes of memory,\n" \
+	"                    writing collapsed directories out to a temporary\n" \
+	"                    file (in $TMPDIR) as needed\n" \
+	"  --lazy=DEPTH      read only pathnames up to DEPTH names long at first,\n" \
+	"                    and the rest of FILE as it's expanded\n" \
+	"  --scan=DIR        go through DIR as du -a would, instead of reading\n" \
+	"                    du's output\n" \
+	"  --watch           with --scan, keep the tree up to date as things in\n" \
+	"                    DIR change\n" \
+	"  --progressive     with --scan, start with only DIR read and estimates\n" \
+	"                    for the rest, reading it breadth first while the\n" \
+	"                    interface runs\n" \
+	"  -V, --version     show version, license terms\n" \
+	"batch queries (any of these prints a listing instead of running\n" \
+	"the interface):\n" \
+	"  -p, --path=PATH   start at PATH instead of the top\n" \
+	"  -L, --depth=N     list N levels below it (default 1, or all with -t)\n" \
+	"  -t, --top=K       list only the K largest entries\n" \
+	"  -m, --min-size=SIZE\n" \
+	"                    leave out entries smaller than SIZE\n" \
+	"  -f, --format=FORMAT\n" \
+	"                    text (the default), tsv, or json\n" \
+	"  -w, --where=EXPR  list only entries matching EXPR, such as\n" \
+	"                    'dir && descendents > 100k && size < 1G', at any\n" \
+	"                    depth unless -L is given\n" \
+	"  --export-columns=DIR\n" \
+	"                    write the whole tree into DIR as a binary file per\n" \
+	"                    column, for loading into a database\n" \
+	"shared trees:\n" \
+	"  --serve=SOCKET    keep the tree in memory for clients to attach to\n" \
+	"  --attach=SOCKET   run the interface on a tree served at SOCKET\n" \
+	"  --replay=SCRIPT   run the keys in SCRIPT against the interface,\n" \
+	"                    offscreen, and report how long they took\n"
 
 void
 version_exit (int status)
@@ -64,12 +148,39 @@ typedef struct options {
 	bool help;
 	int optind;
 	bool parse_only;
+	bool batch;
+	batch_query_s query;
+	const char *serve;
+	const char *attach;
+	const char *replay;
+	const char *export_dir;
+	const char *scan;	/* directory to go through instead */
+	bool watch;
+	bool progressive;
+	char *metric_args[METRIC_MAX];
+	int nmetric_args;
+	int lazy;		/* depth to read at first, or 0 for all */
 } options_s;
 
+/* Parse a nonnegative number for an option, or exit. */
+long
+number_option (const char *arg, const char *what)
+{
+	char *end;
+	long n = strtol(arg, &end, 10);
+	if (end == arg || *end || n < 0) {
+		fprintf(stderr, "%s: invalid %s: %s\n", progname, what, arg);
+		exit(1);
+	}
+	return n;
+}
+
 options_s *
 get_options (int argc, char **argv)
 {
 	options_s *options;
+	char *memory_limit = NULL;
+	char *min_size = NULL;
 	int c;
 
 	options = malloc(sizeof(options_s));
@@ -80,6 +191,17 @@ get_options (int argc, char **argv)
 	options->help = 1;
 	options->optind = -1;
 	options->parse_only = 0;
+	options->batch = 0;
+	options->serve = NULL;
+	options->attach = NULL;
+	options->replay = NULL;
+	options->export_dir = NULL;
+	options->scan = NULL;
+	options->watch = 0;
+	options->progressive = 0;
+	options->nmetric_args = 0;
+	options->lazy = 0;
+	batch_query_init(&options->query);
 
 	while ((c = getopt_long(argc, argv, optstring,
 				long_options, NULL)) != -1) {
@@ -108,12 +230,121 @@ get_options (int argc, char **argv)
 		case 'P':
 			options->parse_only = 1;
 			break;
+		case 'B':
+		{
+			TDU_SIZE_T size;
+			tdu_block_size = 1;
+			if (!parse_size(optarg, &size) || !size) {
+				fprintf(stderr, "%s: invalid block size: %s\n",
+					progname, optarg);
+				exit(1);
+			}
+			tdu_block_size = size;
+			break;
+		}
+		case 'R':
+			tdu_rollup = number_option(optarg, "rollup count");
+			break;
+		case 'M':
+			if (!strchr(optarg, '=') || *optarg == '=') {
+				fprintf(stderr, "%s: --metric wants NAME=FILE: %s\n",
+					progname, optarg);
+				exit(1);
+			}
+			if (options->nmetric_args == METRIC_MAX) {
+				fprintf(stderr, "%s: at most %d metrics\n",
+					progname, METRIC_MAX);
+				exit(1);
+			}
+			options->metric_args[options->nmetric_args++] = optarg;
+			break;
+		case 'H':
+			history_add(optarg);
+			break;
+		case 't':
+			options->batch = 1;
+			options->query.top = number_option(optarg, "count");
+			break;
+		case 'L':
+			options->batch = 1;
+			options->query.depth = number_option(optarg, "depth");
+			break;
+		case 'p':
+			options->batch = 1;
+			options->query.path = optarg;
+			break;
+		case 'm':
+			options->batch = 1;
+			min_size = optarg;
+			break;
+		case 'w':
+			options->batch = 1;
+			options->query.where = optarg;
+			break;
+		case 'S':
+			options->serve = optarg;
+			break;
+		case 'a':
+			options->attach = optarg;
+			break;
+		case 'x':
+			memory_limit = optarg;
+			break;
+		case 'r':
+			options->replay = optarg;
+			break;
+		case 'E':
+			options->export_dir = optarg;
+			break;
+		case 'D':
+			options->scan = optarg;
+			break;
+		case 'W':
+			options->watch = 1;
+			break;
+		case 'g':
+			options->progressive = 1;
+			break;
+		case 'N':
+			tdu_natural_sort = 1;
+			break;
+		case 'y':
+			options->lazy = number_option(optarg, "depth");
+			break;
+		case 'f':
+			options->batch = 1;
+			options->query.format = batch_parse_format(optarg);
+			if (options->query.format < 0) {
+				fprintf(stderr, "%s: unknown format: %s\n",
+					progname, optarg);
+				exit(1);
+			}
+			break;
 		default:
 			usage_exit(1);
 			break;
 		}
 	}
 
+	/* sizes with suffixes are converted using the block size */
+	if (min_size && !parse_size(min_size, &options->query.min_size)) {
+		fprintf(stderr, "%s: invalid size: %s\n", progname, min_size);
+		exit(1);
+	}
+	if (memory_limit) {
+		char *end;
+
+		if (!parse_size(memory_limit, &tdu_memory_limit)) {
+			fprintf(stderr, "%s: invalid memory limit: %s\n",
+				progname, memory_limit);
+			exit(1);
+		}
+		/* but this one is in bytes, suffix or not */
+		strtod(memory_limit, &end);
+		if (*end)
+			tdu_memory_limit *= tdu_block_size;
+	}
+
 	options->optind = optind;
 	return options;
 }
@@ -123,6 +354,8 @@ main (int argc, char **argv)
 {
 	node_s *node;
 	options_s *options;
+	const char *history_failed;
+	int i;
 
 	if (NULL == (options = get_options(argc, argv))) {
 		--argc, ++argv;
@@ -132,13 +365,82 @@ main (int argc, char **argv)
 		argv += options->optind;
 	}
 
-	node = parse_file(*argv);
+	if (options->attach) {
+		return attach_run(options->attach);
+	}
+
+	if (options->watch && !options->scan) {
+		fprintf(stderr, "%s: --watch needs --scan\n", progname);
+		return 1;
+	}
+	if (options->watch && !options->batch && !options->export_dir
+	    && watch_start()) {
+		fprintf(stderr, "%s: inotify: %s\n", progname,
+			strerror(errno));
+		return 1;
+	}
+
+	/* a scan is only left for later for the interface to finish */
+	if (options->scan && options->progressive && !options->batch
+	    && !options->export_dir && !options->serve && !options->replay
+	    && !options->parse_only)
+		node = bfs_start(options->scan);
+	else if (options->scan)
+		node = walk_tree(options->scan);
+	else if (options->lazy && *argv && strcmp(*argv, "-"))
+		node = lazy_parse_file(*argv, options->lazy);
+	else
+		node = parse_file(*argv);
+
+	for (i = 0; node && i < options->nmetric_args; ++i) {
+		char *file = strchr(options->metric_args[i], '=');
+		*file++ = '\0';
+		if (metric_load(node, options->metric_args[i], file)) {
+			fprintf(stderr, "%s: %s: %s\n", progname, file,
+				strerror(errno));
+			return 1;
+		}
+	}
+
+	if (node && history_load(node, *argv, &history_failed)) {
+		fprintf(stderr, "%s: %s: %s\n", progname, history_failed,
+			strerror(errno));
+		return 1;
+	}
 
 	if (options->parse_only) {
 		return 0;
 	}
 
+	if (options->export_dir) {
+		return node ? export_columns(node, options->export_dir) : 1;
+	}
+
+	if (options->batch) {
+		return node ? batch_run(node, &options->query, stdout) : 1;
+	}
+
+	if (node && options->serve) {
+		expand_tree(node, 1);
+		return server_run(node, options->serve);
+	}
+
+	/* directories are only folded into their only subdirectories for
+	   browsing, not in anything written out, and not where inotify
+	   events have to find every directory by id */
+	if (node && !options->watch) {
+		tdu_fold = 1;
+		fold_tree(node);
+	}
+
+	if (node && options->replay) {
+		search_index_start();
+		expand_tree(node, 1);
+		return replay_run(node, options->replay);
+	}
+
 	if (node) {
+		if (!bfs_pending()) search_index_start();
 		expand_tree(node, 1);
 		tdu_interface_run(node);
 	}
@@ -146,19 +448,22 @@ main (int argc, char **argv)
 	return 0;
 }
 
+/* Write a message to the trace file if TDU_TRACE names one, or else to
+   stderr if DEBUG is set and stderr isn't the terminal. */
 int
 debug (const char *fmt, ...)
 {
 	va_list ap;
-	va_start(ap, fmt);
-	va_end(ap);
+	int result = 0;
 
-	if (getenv("DEBUG") && !isatty(fileno(stderr))) {
-		int result = vfprintf(stderr, fmt, ap);
-		fflush(stderr);
-		return result;
+	va_start(ap, fmt);
+	if (perf_tracing()) {
+		perf_vtrace(fmt, ap);
 	}
-	else {
-		return 0;
+	else if (getenv("DEBUG") && !isatty(fileno(stderr))) {
+		result = vfprintf(stderr, fmt, ap);
+		fflush(stderr);
 	}
+	va_end(ap);
+	return result;
 }
@@ -22,17 +22,35 @@
 #include "tduint.h"
 #include "node.h"
 #include "nowrap.h"
+#include "search.h"
+#include "filter.h"
+#include "sizeindex.h"
+#include "update.h"
+#include "metric.h"
+#include "history.h"
+#include "group.h"
+#include "perf.h"
+#include "watch.h"
+#include "bfs.h"
+#include "sketch.h"
+#include "expr.h"
 
 #include <stdlib.h>
 #include <curses.h>
 #include <stdio.h>
 #include <signal.h>
 #include <sys/ioctl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
 /*
 #include <pty.h>
 */
 #include <string.h>
 #include <errno.h>
+#include <ctype.h>
+#include <limits.h>
 
 node_s *root_node;		/* root node of tree being displayed */
 int cursor_line;		/* line # in tree where "cursor" is located */
@@ -56,6 +74,28 @@ static char *tree_chars_string[] = {
 
 int ascii_tree_chars = 0;
 int show_descendents = 0;
+int show_metrics = 1;
+int show_perf = 0;
+
+/* Keys are read in bursts: every key already waiting is handled before
+   anything is drawn, cursor motions only update cursor_line, and the
+   screen is brought up to date at most once per frame.  SIGWINCH is
+   turned into a byte on resize_pipe so that the resize itself happens
+   in the main loop rather than inside the signal handler. */
+
+static int resize_pipe[2] = { -1, -1 };
+static int refresh_pending = 0;	/* cursor moved since last redraw? */
+static long last_frame = 0;	/* time of last redraw, in milliseconds */
+static int clear_status_line = 0;
+static bool frame_started = 0;	/* drawing since the last refresh? */
+
+static long *search_results = NULL; /* ids of nodes found by last search */
+static long search_nresults = 0;
+static long search_current = -1;
+
+static node_s *unfiltered_root = NULL; /* root_node before filtering */
+static char filter_pattern[1024] = "";
+static char status_text[256] = "";	/* shown when there's no message */
 
 /* Generic function to display "tree branch" characters for a node and
    its parents. */
@@ -77,6 +117,14 @@ display_tree_chars (node_s *node,   /* programs specify node to display */
 	tc = (thisisit
 	      ? (node->is_last_child ? IAM_LAST : IAM_NOTLAST)
 	      : (node->is_last_child ? PARENT_LAST : PARENT_NOTLAST));
+	display_branch(tc);
+}
+
+/* Display one level's worth of tree branch characters. */
+
+void
+display_branch (tree_chars_enum tc)
+{
 	if (ascii_tree_chars) {
 		wprintw_nowrap(main_window, tree_chars_string[tc]);
 	}
@@ -116,12 +164,32 @@ display_node (int line,         /* line number on screen */
 
 	if (!node) return;
 
-	wprintw_nowrap(main_window, "%11ld ", node->size);
+	if (bfs_is_provisional(node))
+		wprintw_nowrap(main_window, "~%10ld ", node->size);
+	else
+		wprintw_nowrap(main_window, "%11ld ", node->size);
+	if (show_metrics) {
+		int m;
+		for (m = 0; m < nmetrics; ++m) {
+			if (node->id < 0)
+				wprintw_nowrap(main_window, "%11s ", "");
+			else
+				wprintw_nowrap(main_window, "%11llu ",
+					       metric_value(m, node));
+		}
+	}
+	if (nsnapshots > 1) {
+		if (node->id < 0)
+			wprintw_nowrap(main_window, "%11s ", "");
+		else
+			wprintw_nowrap(main_window, "%+11lld ",
+				       history_growth(node, history_window));
+	}
 	if (show_descendents)
 		wprintw_nowrap(main_window, "%11ld ", node->descendents);
 	display_tree_chars(node, level, 1);
 	wprintw_nowrap(main_window, "%s", node->name);
-	if (node->nchildren && !node->expanded) {
+	if ((node->nchildren || node_has_unloaded_children(node)) && !node->expanded) {
 		wprintw_nowrap(main_window, " ...");
 	}
 }
@@ -136,7 +204,13 @@ display_nodes (int line,        /* starting line number on screen */
                long cursor)     /* line # within tree where cursor is
                                    located */
 {
-	int nodes = display_nodes_(line, lines, node, nodeline, cursor, 0);
+	int nodes;
+
+	if (!frame_started) {
+		perf_start(&perf_frame, "frame");
+		frame_started = 1;
+	}
+	nodes = display_nodes_(line, lines, node, nodeline, cursor, 0);
 	line += nodes;
 	lines -= nodes;
 	for (; lines > 0; ++line, --lines) {
@@ -155,8 +229,9 @@ display_nodes_ (int line,       /* starting line number on screen */
                 long cursor,    /* line # within tree where cursor is loc'd */
                 int level)      /* level of indentation */
 {
-	long ret = 0; int i; long l;
+	long ret = 0; long i, n; long l;
 
+	++perf_visited;
 	if (!(node && nodeline >= 0 && 
 	      nodeline < (1 + node->expanded) && lines)) return 0;
 
@@ -178,9 +253,11 @@ display_nodes_ (int line,       /* starting line number on screen */
 		/* Now traverse the children to discover which of
 		   those children nodeline refers to a node inside. */
 
+		n = node_nvisible(node);  /* including any rollup */
 		i = 0;                    /* child number */
-		while (i < node->nchildren
-		       && nodeline >= (l = 1 + node->children[i]->expanded)) {
+		while (i < n
+		       && nodeline >= (l = 1 + node_visible_child(node, i)
+				       ->expanded)) {
 			nodeline -= l;
 			cursor -= l;
 			++i;
@@ -191,13 +268,14 @@ display_nodes_ (int line,       /* starting line number on screen */
 		   inside node->children[i].  We may have to display nodes
 		   from one or more of the next children as well. */
 
-		while (i < node->nchildren && lines > 0) {
-			l = display_nodes_(line, lines, node->children[i],
+		while (i < n && lines > 0) {
+			node_s *child = node_visible_child(node, i);
+			l = display_nodes_(line, lines, child,
 					   nodeline, cursor, level+1);
 			ret += l; line += l; lines -= l;
 			nodeline = 0; /* continue at top of next 
 					 child's visible tree */
-			cursor -= (1 + node->children[i]->expanded);
+			cursor -= (1 + child->expanded);
 			++i;
 		}
 	}
@@ -235,6 +313,11 @@ tdu_interface_refresh ()
 {
 	int lines;
 
+	if (!frame_started) {
+		perf_start(&perf_frame, "frame");
+		frame_started = 1;
+	}
+
 	if (prev_start_line < 0) {
 		display_nodes(0, visible_lines, root_node, start_line,
 			      cursor_line);
@@ -286,12 +369,36 @@ tdu_interface_refresh ()
 		}
 	}
 
+	perf_stop(&perf_frame);
+	frame_started = 0;
+	if (show_perf)
+		tdu_interface_perf();
 	wrefresh(status_window);
 	wrefresh(main_window);
 	tdu_show_cursor();
 	prev_start_line = start_line;
 }
 
+/* Show the last frame's and operation's timings and the memory in use
+   on the status line. */
+
+void
+tdu_interface_perf ()
+{
+	char message[256];
+
+	snprintf(message, sizeof(message),
+		 "frame %.2fms %ld nodes | %s %.2fms %ld nodes | RSS %ldK",
+		 perf_frame.ms, perf_frame.visited, perf_op.what,
+		 perf_op.ms, perf_op.visited, perf_rss());
+	tdu_hide_cursor();
+	wmove(status_window, 0, 0);
+	wclrtoeol(status_window);
+	wattron(status_window, A_REVERSE);
+	wprintw_nowrap(status_window, "%s", message);
+	wattroff(status_window, A_REVERSE);
+}
+
 /* Re-display the entire screen */
 
 void
@@ -315,7 +422,17 @@ tdu_interface_expand (int levels, int redraw)
 	n = find_node_numbered(root_node, cursor_line);
 	if (!n) return;
 
+	if (node_is_rollup(n)) {
+		/* the next page is sorted in among the entries above */
+		if (!expand_tree(n, 1)) return;
+		prev_start_line = -1;
+		tdu_interface_refresh();
+		return;
+	}
+
+	perf_start(&perf_op, "expand");
 	scrolllines = expand_tree(n, levels);
+	perf_stop(&perf_op);
 	if (!scrolllines) return;
 
 	if (!redraw && (levels > 1))
@@ -360,7 +477,9 @@ tdu_interface_collapse (int redraw)
 	n = find_node_numbered(root_node, cursor_line);
 	if (!n) return;
 
+	perf_start(&perf_op, "collapse");
 	scrolllines = collapse_tree(n);
+	perf_stop(&perf_op);
 	if (!scrolllines) return;
 
 	if (redraw) {
@@ -391,39 +510,64 @@ tdu_interface_collapse (int redraw)
 	}
 }
 
+/* Cursor motions do not redraw anything; they just move cursor_line and
+   leave it to tdu_interface_flush() to catch the screen up. */
+
 void
 tdu_interface_move_up (int n)
 {
-	cursor_line -= n;
-	tdu_interface_refresh();
+	tdu_interface_move_to(cursor_line - n);
 }
 
 void
 tdu_interface_move_down (int n)
 {
-	cursor_line += n;
-	tdu_interface_refresh();
+	tdu_interface_move_to(cursor_line + n);
 }
 
 void
 tdu_interface_move_to (int n)
 {
 	cursor_line = n;
-	tdu_interface_refresh();
+	if (cursor_line > root_node->expanded)
+		cursor_line = root_node->expanded;
+	if (cursor_line < 0)
+		cursor_line = 0;
+	refresh_pending = 1;
 }
 
 void
 tdu_interface_page_up ()
 {
-	cursor_line -= (visible_lines - 1);
-	tdu_interface_refresh();
+	tdu_interface_move_up(visible_lines - 1);
 }
 
 void
 tdu_interface_page_down ()
 {
-	cursor_line += (visible_lines - 1);
+	tdu_interface_move_down(visible_lines - 1);
+}
+
+/* milliseconds on a clock that doesn't jump around */
+
+static long
+tdu_interface_now ()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+/* Bring the screen up to date with any pending cursor motion. */
+
+void
+tdu_interface_flush ()
+{
+	if (!refresh_pending) return;
+	tdu_hide_cursor();
 	tdu_interface_refresh();
+	refresh_pending = 0;
+	last_frame = tdu_interface_now();
 }
 
 void
@@ -432,6 +576,7 @@ status_line_message (char *message)
 	tdu_hide_cursor();
 	wmove(status_window, 0, 0);
 	wclrtoeol(status_window);
+	if (!message) message = status_text;
 	if (message && *message) {
 		wattron(status_window, A_REVERSE);
 		wprintw_nowrap(status_window, "%s", message);
@@ -450,7 +595,9 @@ tdu_interface_sort (node_sort_fp fp, bool reverse, bool isrecursive)
 		long maxlines = visible_lines - (cursor_line - start_line) - 1;
 
 		status_line_message("sorting...");
+		perf_start(&perf_op, "sort");
 		tree_sort(n, fp, reverse, isrecursive);
+		perf_stop(&perf_op);
 		status_line_message(NULL);
 
 		if (lines > maxlines) lines = maxlines;
@@ -500,8 +647,11 @@ tdu_interface_compute_visible_lines ()
 	visible_lines = ey - by;
 }
 
+/* Recreate the windows at the new terminal size.  Called from the main
+   loop once tdu_interface_resize_handler() has signalled a resize. */
+
 void
-tdu_interface_resize_handler (int sig)
+tdu_interface_resize ()
 {
 	int lines, columns;
 
@@ -514,6 +664,7 @@ tdu_interface_resize_handler (int sig)
 	main_window = newwin(LINES - 1, COLS, 0, 0);
 	status_window = newwin(1, COLS, LINES - 1, 0);
 	keypad(main_window, TRUE);
+	keypad(status_window, TRUE);
 	scrollok(main_window, 1);
 	
 	tdu_interface_compute_visible_lines();
@@ -524,8 +675,24 @@ tdu_interface_resize_handler (int sig)
 	}
 	
 	tdu_interface_display();
+	refresh_pending = 0;
+	last_frame = tdu_interface_now();
 }
 
+/* SIGWINCH handler.  Only async-signal-safe work happens here. */
+
+void
+tdu_interface_resize_handler (int sig)
+{
+	int e = errno;
+	ssize_t n = write(resize_pipe[1], "", 1);
+	(void)n;		/* if the pipe is full, a resize is
+				   already pending anyway */
+	errno = e;
+}
+
+static void tdu_interface_init_windows (void);
+
 void
 tdu_interface_init_ncurses ()
 {
@@ -535,6 +702,34 @@ tdu_interface_init_ncurses ()
 	}
   
 	tdu_window = initscr();
+	tdu_interface_init_windows();
+}
+
+/* Start curses on a terminal that isn't there, writing to /dev/null,
+   for replaying keys without one.  Its size is taken from LINES and
+   COLUMNS, if set. */
+
+void
+tdu_interface_init_offscreen ()
+{
+	FILE *out = fopen("/dev/null", "w");
+	FILE *in = fopen("/dev/null", "r");
+	SCREEN *screen;
+
+	if (!out || !in || !(screen = newterm("vt100", out, in))) {
+		perror("tdu_interface_init_offscreen");
+		exit(1);
+	}
+	set_term(screen);
+	tdu_window = stdscr;
+	tdu_interface_init_windows();
+}
+
+/* Set up the windows on a terminal curses has been started on. */
+
+static void
+tdu_interface_init_windows ()
+{
 	keypad(tdu_window, TRUE);
 	nonl();
 	cbreak();
@@ -545,6 +740,7 @@ tdu_interface_init_ncurses ()
 	status_window = newwin(1, COLS, LINES - 1, 0);
 
 	keypad(main_window, TRUE);
+	keypad(status_window, TRUE);
 	scrollok(main_window, 1);
 	
 	tdu_interface_compute_visible_lines();
@@ -556,6 +752,869 @@ tdu_interface_init_ncurses ()
 	tdu_interface_display();
 }
 
+/* Block until a key is pressed, and return it. */
+
+int
+tdu_interface_wait_key ()
+{
+	int key;
+	nodelay(main_window, FALSE);
+	key = wgetch(main_window);
+	nodelay(main_window, TRUE);
+	return key;
+}
+
+/* Read a line of text typed on the status line into buf, which may
+   already hold some text to start with.  If changed is not NULL, it is
+   called with the text each time it is edited.  Returns 0 if the user
+   cancels with ESC or Control-G. */
+
+int
+tdu_interface_prompt (const char *prompt, char *buf, int size,
+		      void (*changed)(const char *))
+{
+	int len = strlen(buf);
+	int key;
+
+	curs_set(1);
+	while (1) {
+		wmove(status_window, 0, 0);
+		wclrtoeol(status_window);
+		wprintw_nowrap(status_window, "%s%s", prompt, buf);
+		wrefresh(status_window);
+
+		key = wgetch(status_window);
+		switch (key) {
+		case '\r':
+		case '\n':
+		case KEY_ENTER:
+			status_line_message(NULL);
+			return 1;
+		case 27:	/* ESC */
+		case 7:		/* C-g */
+			status_line_message(NULL);
+			return 0;
+		case KEY_BACKSPACE:
+		case 127:	/* DEL */
+		case 8:		/* C-h */
+			if (len) buf[--len] = '\0';
+			break;
+		case 21:	/* C-u */
+			buf[len = 0] = '\0';
+			break;
+		default:
+			if (key < 256 && isprint(key) && len < size - 1) {
+				buf[len++] = key;
+				buf[len] = '\0';
+			}
+			else {
+				beep();
+				continue;
+			}
+			break;
+		}
+		if (changed) changed(buf);
+	}
+}
+
+/* Move the cursor to a node, expanding its ancestors if necessary, and
+   redraw the screen. */
+
+void
+tdu_interface_goto_node (node_s *node)
+{
+	long line;
+
+	if (!node) return;
+	if (unfiltered_root) tdu_interface_filter_off();
+	node_reveal(node);
+	line = find_node_number_in(node, root_node);
+	if (line < 0) return;
+
+	cursor_line = line;
+	if (cursor_line < start_line
+	    || cursor_line >= start_line + visible_lines)
+		start_line = cursor_line - visible_lines / 2;
+	if (start_line > root_node->expanded - (visible_lines - 1))
+		start_line = root_node->expanded - (visible_lines - 1);
+	if (start_line < 0)
+		start_line = 0;
+
+	prev_start_line = -1;	/* force complete refresh */
+	tdu_interface_display();
+	refresh_pending = 0;
+}
+
+/* Go to the next (dir > 0) or previous (dir < 0) match of the last
+   search, wrapping around at either end. */
+
+void
+tdu_interface_search_next (int dir)
+{
+	char message[64];
+	long i;
+
+	for (i = 0; i < search_nresults; ++i) {
+		search_current = (search_current + dir + search_nresults)
+			% search_nresults;
+		if (node_table[search_results[search_current]]) break;
+	}
+	if (i == search_nresults) {
+		status_line_message("No matches.");
+		clear_status_line = 1;
+		tdu_show_cursor();
+		return;
+	}
+
+	tdu_interface_goto_node(node_table[search_results[search_current]]);
+	snprintf(message, sizeof(message), "Match %ld of %ld",
+		 search_current + 1, search_nresults);
+	status_line_message(message);
+	clear_status_line = 1;
+	tdu_show_cursor();
+}
+
+/* Prompt for a substring or regular expression, find the nodes it
+   matches, and go to the first one. */
+
+void
+tdu_interface_search (bool is_regex)
+{
+	char pattern[1024] = "";
+
+	if (!tdu_interface_prompt(is_regex ? "Regex search: " : "Search: ",
+				  pattern, sizeof(pattern), NULL)
+	    || !*pattern) {
+		tdu_show_cursor();
+		return;
+	}
+
+	status_line_message("Searching...");
+	free(search_results);
+	search_results = NULL;
+	search_current = -1;
+	search_nresults = search_find(pattern, is_regex, &search_results);
+	if (search_nresults < 0) {
+		search_nresults = 0;
+		status_line_message("Invalid regular expression.");
+		clear_status_line = 1;
+		tdu_show_cursor();
+		return;
+	}
+	tdu_interface_search_next(1);
+}
+
+/* Display only the nodes with the given ids (in ascending order), and
+   the directories they are in, instead of the whole tree. */
+
+static void
+tdu_interface_filter_show (const char *pattern, const long *ids, long n)
+{
+	node_s *view;
+
+	view = filter_view(unfiltered_root ? unfiltered_root : root_node,
+			   ids, n);
+	if (unfiltered_root)
+		filter_free_view(root_node);
+	else
+		unfiltered_root = root_node;
+	root_node = view;
+
+	snprintf(status_text, sizeof(status_text),
+		 "Filter: %s -- %ld matches, %ld total",
+		 pattern, view->descendents, view->size);
+	cursor_line = start_line = 0;
+	prev_start_line = -1;	/* force complete refresh */
+	tdu_interface_display();
+	refresh_pending = 0;
+}
+
+/* Display only the nodes matching a pattern, and the directories they
+   are in; or everything again if the pattern is empty. */
+
+void
+tdu_interface_filter_apply (const char *pattern)
+{
+	long *ids;
+	long n;
+
+	if (!*pattern) {
+		tdu_interface_filter_off();
+		return;
+	}
+
+	n = filter_match(pattern, &ids);
+	tdu_interface_filter_show(pattern, ids, n);
+}
+
+/* Go back to displaying the whole tree, with the cursor on whatever it
+   was on in the filtered view. */
+
+void
+tdu_interface_filter_off ()
+{
+	node_s *node;
+
+	if (!unfiltered_root) return;
+
+	/* a rollup has no id; go to its directory instead */
+	node = find_node_numbered(root_node, cursor_line);
+	if (node && node_is_rollup(node)) node = node->parent;
+	node = (node && node->id >= 0) ? node_table[node->id] : NULL;
+	filter_free_view(root_node);
+	root_node = unfiltered_root;
+	unfiltered_root = NULL;
+	filter_reset();
+	status_text[0] = '\0';
+	status_line_message(NULL);
+
+	if (node) {
+		tdu_interface_goto_node(node);
+	}
+	else {
+		cursor_line = start_line = 0;
+		prev_start_line = -1;
+		tdu_interface_display();
+	}
+}
+
+void
+tdu_interface_filter ()
+{
+	if (!tdu_interface_prompt("Filter: ", filter_pattern,
+				  sizeof(filter_pattern),
+				  tdu_interface_filter_apply)
+	    || !*filter_pattern) {
+		filter_pattern[0] = '\0';
+		tdu_interface_filter_off();
+	}
+	tdu_show_cursor();
+}
+
+/* Display only the nodes matching an expression such as
+   size > 1G && name ~ *.log (see expr.c), which, unlike a pattern, is
+   only looked up once it has all been typed. */
+
+void
+tdu_interface_filter_expr ()
+{
+	static char text[1024] = "";
+	char error[256], message[300];
+	expr_s *expr;
+	long *ids;
+	long n;
+
+	if (!tdu_interface_prompt("Filter expression: ", text, sizeof(text),
+				  NULL)
+	    || !*text) {
+		text[0] = '\0';
+		tdu_interface_filter_off();
+		tdu_show_cursor();
+		return;
+	}
+	if (!(expr = expr_compile(text, error, sizeof(error)))) {
+		snprintf(message, sizeof(message), "Bad expression: %s", error);
+		status_line_message(message);
+		clear_status_line = 1;
+		tdu_show_cursor();
+		return;
+	}
+	status_line_message("Looking...");
+	n = expr_select(expr, unfiltered_root ? unfiltered_root : root_node,
+			&ids);
+	expr_free(expr);
+	filter_reset();
+	tdu_interface_filter_show(text, ids, n);
+	free(ids);
+	status_line_message(NULL);
+	tdu_show_cursor();
+}
+
+/* Move the cursor in a list of n lines for a key, returning 0 if it
+   isn't a movement key. */
+
+static bool
+pick_move (int key, long *cursor, long n)
+{
+	switch (key) {
+	case 16: case 'K': case 'k': case KEY_UP:
+		--*cursor;
+		return 1;
+	case 14: case 'J': case 'j': case KEY_DOWN:
+		++*cursor;
+		return 1;
+	case KEY_PPAGE:
+		*cursor -= visible_lines - 1;
+		return 1;
+	case KEY_NPAGE:
+	case ' ':
+		*cursor += visible_lines - 1;
+		return 1;
+	case '<': case KEY_HOME:
+		*cursor = 0;
+		return 1;
+	case '>': case KEY_END:
+		*cursor = n - 1;
+		return 1;
+	}
+	return 0;
+}
+
+/* Let the user pick one of a list of nodes (given by id), which are
+   listed one per line with their sizes and pathnames, and go to the
+   node picked. */
+
+void
+tdu_interface_pick (const char *title, const long *ids, long n)
+{
+	char path[PATH_MAX];
+	long cursor = 0, top = 0;
+	int i, key;
+
+	while (1) {
+		if (cursor >= n) cursor = n - 1;
+		if (cursor < 0) cursor = 0;
+		if (cursor < top) top = cursor;
+		if (cursor >= top + visible_lines)
+			top = cursor - (visible_lines - 1);
+
+		werase(main_window);
+		for (i = 0; i < visible_lines && top + i < n; ++i) {
+			node_s *node = node_table[ids[top + i]];
+			if (!node) continue;
+			node_path(node, path, sizeof(path));
+			wmove(main_window, i, 0);
+			if (top + i == cursor) wattron(main_window, A_REVERSE);
+			wprintw_nowrap(main_window, "%11ld %s",
+				       node->size, path);
+			if (top + i == cursor) wattroff(main_window, A_REVERSE);
+		}
+		status_line_message((char *)title);
+		wmove(main_window, cursor - top, 0);
+		wrefresh(main_window);
+
+		key = tdu_interface_wait_key();
+		if (pick_move(key, &cursor, n))
+			continue;
+		switch (key) {
+		case '\r': case '\n': case KEY_ENTER:
+		case 'l': case KEY_RIGHT:
+			status_line_message(NULL);
+			if (n && node_table[ids[cursor]]) {
+				tdu_interface_goto_node(node_table[ids[cursor]]);
+				return;
+			}
+			/* FALLTHROUGH */
+		case 27: case 'q': case 'Q': case 'h': case KEY_LEFT:
+			status_line_message(NULL);
+			prev_start_line = -1;
+			tdu_interface_display();
+			return;
+		default:
+			beep();
+			break;
+		}
+	}
+}
+
+/* List the largest files (or directories) anywhere in the tree. */
+
+void
+tdu_interface_largest (int which)
+{
+	char count[32] = "100";
+	char title[128];
+	long *ids;
+	long n;
+
+	if (!tdu_interface_prompt((which == SIZE_INDEX_FILES)
+				  ? "Number of largest files to list: "
+				  : "Number of largest directories to list: ",
+				  count, sizeof(count), NULL)
+	    || (n = atol(count)) <= 0) {
+		tdu_show_cursor();
+		return;
+	}
+
+	status_line_message("Looking...");
+	n = size_index_top(which, n, &ids);
+	snprintf(title, sizeof(title),
+		 "%ld largest %s -- RETURN to go to one, q to go back", n,
+		 (which == SIZE_INDEX_FILES) ? "files" : "directories");
+	tdu_interface_pick(title, ids, n);
+	free(ids);
+}
+
+/* List the files under the directory at the cursor (or the whole tree
+   at the top) totalled by extension; RETURN lists a group's files. */
+
+void
+tdu_interface_groups ()
+{
+	char path[PATH_MAX];
+	char title[PATH_MAX + 64];
+	node_s *node;
+	group_s *groups;
+	long ngroups, cursor = 0, top = 0, *ids, n;
+	int i, key;
+
+	node = find_node_numbered(root_node, cursor_line);
+	if (node && (node_is_rollup(node)
+		     || !(node->nchildren || node_has_unloaded_children(node))))
+		node = node->parent;
+	if (!node) {
+		tdu_show_cursor();
+		return;
+	}
+	status_line_message("Grouping...");
+	ngroups = group_by_extension(node, &groups);
+	node_path(node, path, sizeof(path));
+
+	while (1) {
+		if (cursor >= ngroups) cursor = ngroups - 1;
+		if (cursor < 0) cursor = 0;
+		if (cursor < top) top = cursor;
+		if (cursor >= top + visible_lines)
+			top = cursor - (visible_lines - 1);
+
+		werase(main_window);
+		for (i = 0; i < visible_lines && top + i < ngroups; ++i) {
+			group_s *g = &groups[top + i];
+			wmove(main_window, i, 0);
+			if (top + i == cursor) wattron(main_window, A_REVERSE);
+			wprintw_nowrap(main_window, "%11llu %9ld files %5.1f%% %s",
+				       g->size, g->files,
+				       node->size > 0
+				       ? 100.0 * g->size / node->size : 0.0,
+				       g->key);
+			if (top + i == cursor) wattroff(main_window, A_REVERSE);
+		}
+		snprintf(title, sizeof(title),
+			 "%ld extensions under %s -- RETURN to list files, q to go back",
+			 ngroups, path);
+		status_line_message(title);
+		wmove(main_window, cursor - top, 0);
+		wrefresh(main_window);
+
+		key = tdu_interface_wait_key();
+		if (pick_move(key, &cursor, ngroups))
+			continue;
+		switch (key) {
+		case '\r': case '\n': case KEY_ENTER:
+		case 'l': case KEY_RIGHT:
+			if (!ngroups) break;
+			n = group_members(node, groups[cursor].key, &ids);
+			snprintf(title, sizeof(title),
+				 "%ld files of %s -- RETURN to go to one, q to go back",
+				 n, groups[cursor].key);
+			free(groups);
+			tdu_interface_pick(title, ids, n);
+			free(ids);
+			return;
+		case 27: case 'q': case 'Q': case 'h': case KEY_LEFT:
+			free(groups);
+			status_line_message(NULL);
+			prev_start_line = -1;
+			tdu_interface_display();
+			return;
+		default:
+			beep();
+			break;
+		}
+	}
+}
+
+/* Write a number of bytes that's a power of two, such as 4K. */
+static void
+sketch_bound (int bucket, char *buf, int size)
+{
+	const char *units = "KMGTPE";
+	int shift = bucket ? bucket - 1 : 0;
+
+	if (!bucket)
+		snprintf(buf, size, "0");
+	else if (shift < 10)
+		snprintf(buf, size, "%d", 1 << shift);
+	else
+		snprintf(buf, size, "%d%c", 1 << (shift % 10),
+			 units[shift / 10 - 1]);
+}
+
+/* Show how the sizes of the files under the directory at the cursor
+   are spread out: whether its space is in a few big files or in a great
+   many small ones. */
+
+void
+tdu_interface_sketch ()
+{
+	char path[PATH_MAX];
+	char text[PATH_MAX + 256 + (SKETCH_BUCKETS + 1) * 80];
+	char lo[16], hi[16], label[40];
+	sketch_s sketch;
+	node_s *node;
+	TDU_SIZE_T size = 0, all, sum;
+	long files = 0, n;
+	int len, b;
+
+	node = find_node_numbered(root_node, cursor_line);
+	if (node && node_is_rollup(node))
+		node = node->parent;
+	if (!node) {
+		tdu_show_cursor();
+		return;
+	}
+	sketch_get(node, &sketch);
+	for (b = 0; b < SKETCH_BUCKETS; ++b) {
+		files += sketch.files[b];
+		size += sketch.size[b];
+	}
+	all = size + sketch.size[SKETCH_UNREAD];
+	node_path(node, path, sizeof(path));
+	len = snprintf(text, sizeof(text),
+		       "Sizes of the %ld files under %s (%llu in all):\n\n",
+		       files, *path ? path : "the top", all);
+
+	/* the fewest biggest files holding half the space */
+	for (b = SKETCH_BUCKETS - 1, sum = n = 0; b > 0 && sum * 2 < size; --b) {
+		sum += sketch.size[b];
+		n += sketch.files[b];
+	}
+	if (n && sum * 2 >= size && b < SKETCH_BUCKETS - 1) {
+		sketch_bound(b + 1, lo, sizeof(lo));
+		len += snprintf(text + len, sizeof(text) - len,
+				"  %.0f%% of the space is in %ld %s of %sB or more\n",
+				100.0 * sum / all, n, n == 1 ? "file" : "files", lo);
+	}
+	/* and the smallest files making up half of them */
+	for (b = 0, sum = n = 0; b < SKETCH_BUCKETS && n * 2 < files; ++b) {
+		sum += sketch.size[b];
+		n += sketch.files[b];
+	}
+	if (n && b < SKETCH_BUCKETS) {
+		sketch_bound(b, hi, sizeof(hi));
+		len += snprintf(text + len, sizeof(text) - len,
+				"  %.0f%% of the files are under %sB, holding %.0f%% of the space\n",
+				100.0 * n / files, hi,
+				all ? 100.0 * sum / all : 0.0);
+	}
+	len += snprintf(text + len, sizeof(text) - len,
+			"\n  %-16s %11s %6s %11s %6s\n",
+			"SIZE", "FILES", "", "SPACE", "");
+	for (b = 0; b <= SKETCH_BUCKETS && len < sizeof(text); ++b) {
+		if (!sketch.files[b]) continue;
+		sketch_bound(b, lo, sizeof(lo));
+		sketch_bound(b + 1, hi, sizeof(hi));
+		if (b == SKETCH_UNREAD)
+			snprintf(label, sizeof(label), "not read yet");
+		else if (b)
+			snprintf(label, sizeof(label), "%sB-%sB", lo, hi);
+		else
+			snprintf(label, sizeof(label), "empty");
+		len += snprintf(text + len, sizeof(text) - len,
+				"  %-16s %11ld %5.1f%% %11llu %5.1f%%\n",
+				label, sketch.files[b],
+				files ? 100.0 * sketch.files[b] / files : 0.0,
+				sketch.size[b],
+				all ? 100.0 * sketch.size[b] / all : 0.0);
+	}
+	text[sizeof(text) - 1] = '\0';
+	tdu_interface_help(text);
+}
+
+/* List the files and directories whose sizes are in a range. */
+
+void
+tdu_interface_size_range ()
+{
+	static char range[64] = "";
+	char title[128];
+	char *dash;
+	TDU_SIZE_T min = 0, max = (TDU_SIZE_T)-1;
+	long *ids;
+	long n;
+
+	if (!tdu_interface_prompt("Size range (MIN-MAX, MIN-, or -MAX): ",
+				  range, sizeof(range), NULL)
+	    || !*range) {
+		tdu_show_cursor();
+		return;
+	}
+
+	dash = strchr(range, '-');
+	if (dash) *dash = '\0';
+	if ((*range && !parse_size(range, &min))
+	    || (dash && dash[1] && !parse_size(dash + 1, &max))) {
+		if (dash) *dash = '-';
+		status_line_message("Invalid size range.");
+		clear_status_line = 1;
+		tdu_show_cursor();
+		return;
+	}
+	if (dash) *dash = '-';
+
+	status_line_message("Looking...");
+	n = size_index_range(SIZE_INDEX_ALL, min, max, &ids);
+	if (!n) {
+		status_line_message("Nothing that size.");
+		clear_status_line = 1;
+		tdu_show_cursor();
+		return;
+	}
+	snprintf(title, sizeof(title),
+		 "%ld entries of %s -- RETURN to go to one, q to go back",
+		 n, range);
+	tdu_interface_pick(title, ids, n);
+	free(ids);
+}
+
+/* Say which metric columns are shown, in order, marking the one v and
+   V sort by.  If next is nonzero, pick the next one to sort by first. */
+
+void
+tdu_interface_metrics (int next)
+{
+	char message[256];
+	int m, len;
+
+	if (!nmetrics) {
+		status_line_message("No metrics loaded (see --metric).");
+		clear_status_line = 1;
+		tdu_show_cursor();
+		return;
+	}
+	if (next)
+		metric_sort_column = (metric_sort_column + 1) % nmetrics;
+
+	len = snprintf(message, sizeof(message), "%s: size",
+		       show_metrics ? "Columns" : "Columns (hidden)");
+	for (m = 0; m < nmetrics && len < sizeof(message); ++m)
+		len += snprintf(message + len, sizeof(message) - len,
+				(m == metric_sort_column) ? ", [%s]" : ", %s",
+				metrics[m].name);
+	status_line_message(message);
+	clear_status_line = 1;
+	tdu_show_cursor();
+}
+
+/* Switch the growth column, and g and G, between the last week and
+   the last month. */
+
+void
+tdu_interface_growth_window ()
+{
+	char message[256];
+
+	if (nsnapshots < 2) {
+		status_line_message("No history loaded (see --history).");
+		clear_status_line = 1;
+		tdu_show_cursor();
+		return;
+	}
+	history_window = (history_window == HISTORY_SHORT_WINDOW)
+		? HISTORY_LONG_WINDOW : HISTORY_SHORT_WINDOW;
+	prev_start_line = -1;
+	tdu_interface_display();
+	snprintf(message, sizeof(message),
+		 "Growth over the last %d days, of %d snapshots",
+		 history_window, nsnapshots);
+	status_line_message(message);
+	clear_status_line = 1;
+	tdu_show_cursor();
+}
+
+/* Apply newer du output to the tree, keeping the same directories
+   expanded and the cursor on the same entry if it's still there. */
+
+void
+tdu_interface_update ()
+{
+	static char filename[PATH_MAX] = "";
+	char message[PATH_MAX + 64];
+	node_s *top, *node, *root;
+	long *expanded;
+	long nexpanded, changed, id, root_id;
+
+	if (!tdu_interface_prompt("Update from du output in file: ",
+				  filename, sizeof(filename), NULL)
+	    || !*filename) {
+		tdu_show_cursor();
+		return;
+	}
+	if (unfiltered_root) tdu_interface_filter_off();
+	free(search_results);
+	search_results = NULL;
+	search_nresults = 0;
+	search_current = -1;
+
+	node = find_node_numbered(root_node, cursor_line);
+	id = node ? node->id : -1;
+	root = root_node;
+	root_id = root_node->id;
+	for (top = root_node; top->parent; top = top->parent)
+		;
+
+	status_line_message("Updating...");
+	nexpanded = tree_save_expanded(top, &expanded);
+	collapse_tree(top);
+	changed = update_tree(top, filename);
+	if (tdu_fold) fold_tree(top);	/* looking paths up unfolds chains */
+	tree_restore_expanded(expanded, nexpanded);
+	free(expanded);
+
+	if (changed < 0) {
+		snprintf(message, sizeof(message), "%s: %s", filename,
+			 strerror(errno));
+		status_line_message(message);
+		clear_status_line = 1;
+		prev_start_line = -1;
+		tdu_interface_display();
+		return;
+	}
+	search_index_start();
+
+	/* the top directory itself may have gone, so root_node can't be
+	   looked at until it's known not to have */
+	if (root != top && (root_id < 0 || node_table[root_id] != root))
+		root_node = (top->nchildren == 1) ? top->children[0] : top;
+	if (!root_node->expanded)
+		expand_tree(root_node, 1);
+
+	node = (id >= 0) ? node_table[id] : NULL;
+	if (node) {
+		tdu_interface_goto_node(node);
+	}
+	else {
+		prev_start_line = -1;
+		tdu_interface_display();
+	}
+	snprintf(message, sizeof(message), "%ld %s changed.", changed,
+		 (changed == 1) ? "entry" : "entries");
+	status_line_message(message);
+	clear_status_line = 1;
+}
+
+/* Read more of a --progressive scan, what's on screen first. */
+
+void
+tdu_interface_bfs ()
+{
+	node_s **visible;
+	char message[64];
+	long i, n = 0;
+
+	if (!(visible = malloc(visible_lines * sizeof(node_s *)))) {
+		perror("tdu_interface_bfs: malloc");
+		exit(1);
+	}
+	for (i = 0; i < visible_lines; ++i) {
+		node_s *node = find_node_numbered(root_node, start_line + i);
+		if (!node) break;
+		visible[n++] = node;
+	}
+	n = bfs_step(BFS_SLICE_MS, visible, n);
+	free(visible);
+	if (!n) return;
+
+	if (!clear_status_line) {
+		if (bfs_pending()) {
+			snprintf(message, sizeof(message),
+				 "Scanning: %ld directories to go",
+				 bfs_pending());
+			status_line_message(message);
+		}
+		else {
+			status_line_message(NULL);
+		}
+	}
+	prev_start_line = -1;
+	refresh_pending = 1;
+}
+
+/* The entries on screen while the tree is being reshaped by --watch. */
+static long *watch_expanded = NULL;
+static long watch_nexpanded = 0;
+static long watch_cursor_id = -1;
+/* root_node, which may be freed while the tree is reshaped, and the
+   top of the tree, which isn't */
+static node_s *watch_root = NULL;
+static long watch_root_id = -1;
+static node_s *watch_top = NULL;
+
+static void
+tdu_interface_watch_reshape ()
+{
+	node_s *node, *top;
+
+	if (unfiltered_root) tdu_interface_filter_off();
+	free(search_results);
+	search_results = NULL;
+	search_nresults = 0;
+	search_current = -1;
+
+	node = find_node_numbered(root_node, cursor_line);
+	watch_cursor_id = node ? node->id : -1;
+	watch_root = root_node;
+	watch_root_id = root_node->id;
+	for (top = root_node; top->parent; top = top->parent)
+		;
+	watch_top = top;
+	watch_nexpanded = tree_save_expanded(top, &watch_expanded);
+	collapse_tree(top);
+}
+
+/* Apply what --watch has seen change.  Sizes are simply redrawn; when
+   entries come or go, the tree is collapsed while they do, as for
+   tdu_interface_update(), and the view is kept where it was. */
+
+void
+tdu_interface_watch ()
+{
+	node_s *node, *top;
+	long line;
+
+	watch_expanded = NULL;
+	if (!watch_read(tdu_interface_watch_reshape) && !watch_expanded)
+		return;
+
+	if (watch_expanded) {
+		top = watch_top;
+		tree_restore_expanded(watch_expanded, watch_nexpanded);
+		free(watch_expanded);
+		watch_expanded = NULL;
+		search_index_start();
+
+		if (watch_root != top && (watch_root_id < 0
+		    || node_table[watch_root_id] != watch_root))
+			root_node = (top->nchildren == 1)
+				? top->children[0] : top;
+		if (!root_node->expanded)
+			expand_tree(root_node, 1);
+
+		node = (watch_cursor_id >= 0)
+			? node_table[watch_cursor_id] : NULL;
+		line = node ? find_node_number_in(node, root_node) : -1;
+		if (line >= 0)
+			cursor_line = line;
+		else if (cursor_line > root_node->expanded)
+			cursor_line = root_node->expanded;
+		if (cursor_line < start_line
+		    || cursor_line >= start_line + visible_lines)
+			start_line = cursor_line - visible_lines / 2;
+		if (start_line > root_node->expanded - (visible_lines - 1))
+			start_line = root_node->expanded - (visible_lines - 1);
+		if (start_line < 0)
+			start_line = 0;
+	}
+	if (watch_overflowed) {
+		status_line_message("Some changes were missed; "
+				    "sizes may be off.");
+		clear_status_line = 1;
+		watch_overflowed = 0;
+	}
+	prev_start_line = -1;
+	refresh_pending = 1;
+}
+
 void
 tdu_interface_help (char *message)
 {
@@ -584,7 +1643,7 @@ tdu_interface_help (char *message)
 			if (y >= (maxy - 1)) {
 				wrefresh(main_window);
 				status_line_message("More... (press any key)");
-				wgetch(main_window);
+				tdu_interface_wait_key();
 				status_line_message(NULL);
 				werase(main_window);
 				wmove(main_window, 0, 0);
@@ -596,21 +1655,68 @@ tdu_interface_help (char *message)
 	}
 	wrefresh(main_window);
 	status_line_message("Press any key to continue.");
-	wgetch(main_window);
+	tdu_interface_wait_key();
 	status_line_message(NULL);
 
 	prev_start_line = -1;	/* force complete refresh */
 	tdu_interface_display();
 }
 
+/* Keys that only move the cursor. */
+
+int
+tdu_interface_is_motion (int key)
+{
+	switch (key) {
+	case 16: case 'K': case 'k': case KEY_PREVIOUS: case KEY_UP:
+	case 14: case 'J': case 'j': case KEY_NEXT: case KEY_DOWN:
+	case '<': case KEY_HOME: case '>': case KEY_END:
+	case KEY_SPREVIOUS: case KEY_SNEXT: case KEY_PPAGE: case KEY_NPAGE:
+	case 'P': case 'p':
+		return 1;
+	}
+	return 0;
+}
+
+static void tdu_interface_keypress_ (int key);
+
+/* Handle a key, timing it for the trace file. */
+
 void
 tdu_interface_keypress (int key)
+{
+	perf_stat_s stat, op = perf_op;
+	const char *name;
+
+	if (!perf_tracing()) {
+		tdu_interface_keypress_(key);
+		return;
+	}
+	perf_start(&stat, "key");
+	tdu_interface_keypress_(key);
+	perf_stop(&stat);
+	name = keyname(key);
+	perf_trace("key %s %.3fms %ld nodes cursor %d start %d\n",
+		   name ? name : "?", stat.ms, stat.visited,
+		   cursor_line, start_line);
+	if (memcmp(&op, &perf_op, sizeof(op)))
+		perf_trace("  %s %.3fms %ld nodes\n", perf_op.what,
+			   perf_op.ms, perf_op.visited);
+}
+
+static void
+tdu_interface_keypress_ (int key)
 {
 	int sortrecursive;
 	static int expandlevel = 0;
 	static int lastkey = -1;
 
 	sortrecursive = (lastkey == '=');
+
+	/* anything other than cursor motion draws on the screen as it
+	   goes, so the screen has to be caught up first. */
+	if (!tdu_interface_is_motion(key))
+		tdu_interface_flush();
 	
 	switch (key) {
 
@@ -646,7 +1752,6 @@ tdu_interface_keypress (int key)
 	case 'k':
 	case KEY_PREVIOUS:
 	case KEY_UP:
-		tdu_hide_cursor();
 		tdu_interface_move_up(1);
 		break;
 
@@ -655,39 +1760,32 @@ tdu_interface_keypress (int key)
 	case 'J':
 	case KEY_NEXT:
 	case KEY_DOWN:
-		tdu_hide_cursor();
 		tdu_interface_move_down(1);
 		break;
 
 	case '<':
 	case KEY_HOME:
-		tdu_hide_cursor();
 		tdu_interface_move_to(0);
 		break;
 
 	case '>':
 	case KEY_END:
-		tdu_hide_cursor();
 		tdu_interface_move_to(root_node->expanded);
 		break;
 
 	case KEY_SPREVIOUS:
-		tdu_hide_cursor();
 		tdu_interface_move_up(10);
 		break;
 
 	case KEY_SNEXT:
-		tdu_hide_cursor();
 		tdu_interface_move_down(10);
 		break;
 
 	case KEY_PPAGE:
-		tdu_hide_cursor();
 		tdu_interface_page_up();
 		break;
 
 	case KEY_NPAGE:
-		tdu_hide_cursor();
 		tdu_interface_page_down();
 		break;
 
@@ -697,7 +1795,6 @@ tdu_interface_keypress (int key)
 		node_s *node = find_node_numbered(root_node, cursor_line);
 		node_s *parent = node ? node->parent : NULL;
 		if (parent) {
-			tdu_hide_cursor();
 			tdu_interface_move_to(find_node_number_in(parent,
 								  root_node));
 		}
@@ -753,6 +1850,107 @@ tdu_interface_keypress (int key)
 		wrefresh(main_window);
 		break;
 
+	case '/':
+		tdu_interface_search(0);
+		break;
+
+	case '~':
+		tdu_interface_search(1);
+		break;
+
+	case 'f':
+		tdu_interface_filter();
+		break;
+
+	case 'F':
+		tdu_interface_filter_expr();
+		break;
+
+	case 't':
+		tdu_interface_largest(SIZE_INDEX_FILES);
+		break;
+
+	case 'T':
+		tdu_interface_largest(SIZE_INDEX_DIRS);
+		break;
+
+	case 'e':
+	case 'E':
+		tdu_interface_groups();
+		break;
+
+	case 'i':
+	case 'I':
+		tdu_interface_sketch();
+		break;
+
+	case 'z':
+	case 'Z':
+		tdu_interface_size_range();
+		break;
+
+	case 'r':
+	case 'R':
+		tdu_interface_update();
+		break;
+
+	case 'v':
+	case 'V':
+		if (!nmetrics) {
+			status_line_message("No metrics loaded (see --metric).");
+			clear_status_line = 1;
+			tdu_show_cursor();
+			break;
+		}
+		tdu_interface_sort(node_cmp_metric,
+				   key == 'V', sortrecursive);
+		break;
+
+	case 'm':
+		tdu_interface_metrics(1);
+		break;
+
+	case 'g':
+	case 'G':
+		if (nsnapshots < 2) {
+			status_line_message("No history loaded (see --history).");
+			clear_status_line = 1;
+			tdu_show_cursor();
+			break;
+		}
+		tdu_interface_sort(node_cmp_growth,
+				   key == 'G', sortrecursive);
+		break;
+
+	case 'w':
+		tdu_interface_growth_window();
+		break;
+
+	case 'M':
+		show_metrics = !show_metrics;
+		prev_start_line = -1;
+		tdu_interface_display();
+		tdu_interface_metrics(0);
+		break;
+
+	case ']':
+		tdu_interface_search_next(1);
+		break;
+
+	case '[':
+		tdu_interface_search_next(-1);
+		break;
+
+	case 'o':
+	case 'O':
+		show_perf = !show_perf;
+		if (show_perf)
+			tdu_interface_perf();
+		else
+			status_line_message(NULL);
+		tdu_show_cursor();
+		break;
+
 	case '#':
 		show_descendents = !show_descendents;
 		prev_start_line = -1;
@@ -799,37 +1997,123 @@ tdu_interface_keypress (int key)
 	lastkey = key;
 }
 
+/* Handle every key that has already arrived without drawing in between
+   (except where a key has to draw), so that auto-repeat and pasted input
+   cost one redraw instead of one per key. */
+
 void
-tdu_interface_run (node_s *node)
+tdu_interface_read_keys ()
 {
 	int key;
-	int clear_status_line;
 
+	while ((key = wgetch(main_window)) != ERR) {
+		if (clear_status_line) {
+			status_line_message(NULL);
+			tdu_show_cursor();
+			clear_status_line = 0;
+		}
+		tdu_interface_keypress(key);
+	}
+}
+
+void
+tdu_interface_make_resize_pipe ()
+{
+	int i;
+
+	if (pipe(resize_pipe)) {
+		perror("tdu_interface_make_resize_pipe: pipe");
+		exit(1);
+	}
+	for (i = 0; i < 2; ++i) {
+		fcntl(resize_pipe[i], F_SETFL,
+		      fcntl(resize_pipe[i], F_GETFL) | O_NONBLOCK);
+		fcntl(resize_pipe[i], F_SETFD, FD_CLOEXEC);
+	}
+}
+
+/* Display the tree under node, or its only child if it has just one. */
+
+void
+tdu_interface_set_root (node_s *node)
+{
 	root_node = node;
 	if (root_node->nchildren == 1) {
 		root_node = root_node->children[0];
 	}
+}
+
+void
+tdu_interface_run (node_s *node)
+{
+	struct pollfd fds[3];
+	char buf[64];
+	int timeout, nfds;
+	long wait;
 
+	tdu_interface_set_root(node);
+
+	tdu_interface_make_resize_pipe();
 	signal(SIGINT,   tdu_interface_finish);
 	signal(SIGWINCH, tdu_interface_resize_handler);
 
 	tdu_interface_init_ncurses();
+	nodelay(main_window, TRUE);
 
 	status_line_message("This is tdu.  Type ? for help.  "
 			    "Type C for license terms.");
 	clear_status_line = 1;
 	tdu_show_cursor();
 
-	tdu_show_cursor();
-
 	while (1) {
-		key = wgetch(main_window);
-		if (clear_status_line) {
-			status_line_message(NULL);
-			tdu_show_cursor();
-			clear_status_line = 0;
+		/* redraw if a frame is due, otherwise sleep until it is
+		   or until something happens. */
+		timeout = -1;
+		if (refresh_pending) {
+			wait = (last_frame + 1000 / TDU_FRAME_RATE
+				- tdu_interface_now());
+			if (wait <= 0) {
+				tdu_interface_flush();
+				continue;
+			}
+			timeout = wait;
+		}
+		/* the rest of a scan is read whenever nothing else is
+		   waiting */
+		if (bfs_pending())
+			timeout = 0;
+
+		fds[0].fd = fileno(stdin);
+		fds[0].events = POLLIN;
+		fds[1].fd = resize_pipe[0];
+		fds[1].events = POLLIN;
+		nfds = 2;
+		if (watch_fileno() >= 0) {
+			fds[2].fd = watch_fileno();
+			fds[2].events = POLLIN;
+			nfds = 3;
+		}
+
+		if (poll(fds, nfds, timeout) < 0) {
+			if (errno == EINTR) continue;
+			tdu_interface_finish(-1);
+			perror("tdu_interface_run: poll");
+			exit(1);
+		}
+
+		if (fds[1].revents & POLLIN) {
+			while (read(resize_pipe[0], buf, sizeof(buf)) > 0)
+				;
+			tdu_interface_resize();
+		}
+		if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+			tdu_interface_read_keys();
+		}
+		if (nfds > 2 && (fds[2].revents & POLLIN)) {
+			tdu_interface_watch();
+		}
+		if (bfs_pending() && !fds[0].revents) {
+			tdu_interface_bfs();
 		}
-		tdu_interface_keypress(key);
 	}
 }
-
@@ -27,6 +27,20 @@
 #include "node.h"
 
 extern int ascii_tree_chars;
+extern int show_descendents;
+extern int show_metrics;
+extern int show_perf;
+extern node_s *root_node;
+extern int cursor_line;
+extern int start_line;
+extern int prev_start_line;
+extern int visible_lines;
+extern WINDOW *main_window;
+extern WINDOW *status_window;
+
+/* upper limit on how often the screen is redrawn while the cursor is
+   moving, in frames per second */
+#define TDU_FRAME_RATE 60
 
 /* different types of "tree branches" that can be displayed" */
 typedef enum tree_chars {
@@ -37,6 +51,7 @@ typedef enum tree_chars {
 } tree_chars_enum;
 
 void display_tree_chars (node_s *node, int levelsleft, int thisisit);
+void display_branch (tree_chars_enum tc);
 void display_node (int line, node_s *node, int level);
 int display_nodes (int line, int lines, node_s *node, long nodeline,
 		   long cursor);
@@ -54,7 +69,39 @@ void tdu_interface_move_down (int n);
 void tdu_interface_move_to (int n);
 void tdu_interface_page_up (void);
 void tdu_interface_page_down (void);
+void tdu_interface_flush (void);
 void tdu_interface_sort (node_sort_fp fp, bool reverse, bool isrecursive);
+int tdu_interface_prompt (const char *prompt, char *buf, int size,
+			  void (*changed)(const char *));
+void tdu_interface_goto_node (node_s *node);
+void tdu_interface_search_next (int dir);
+void tdu_interface_search (bool is_regex);
+void tdu_interface_filter_apply (const char *pattern);
+void tdu_interface_filter_off (void);
+void tdu_interface_filter (void);
+void tdu_interface_filter_expr (void);
+void tdu_interface_pick (const char *title, const long *ids, long n);
+void tdu_interface_largest (int which);
+void tdu_interface_size_range (void);
+void tdu_interface_groups (void);
+void tdu_interface_sketch (void);
+void tdu_interface_metrics (int next);
+void tdu_interface_growth_window (void);
+void tdu_interface_update (void);
+void tdu_interface_watch (void);
+void tdu_interface_bfs (void);
+void status_line_message (char *message);
+void tdu_interface_help (char *message);
+void tdu_interface_init_ncurses (void);
+void tdu_interface_init_offscreen (void);
+void tdu_interface_resize (void);
+void tdu_interface_resize_handler (int sig);
+int tdu_interface_wait_key (void);
+int tdu_interface_is_motion (int key);
+void tdu_interface_keypress (int key);
+void tdu_interface_perf (void);
+void tdu_interface_read_keys (void);
+void tdu_interface_set_root (node_s *node);
 void tdu_interface_run (node_s *node);
 
 #define TDU_ONLINE_HELP \
@@ -66,14 +113,33 @@ void tdu_interface_run (node_s *node);
 "EXPANDING/COLLAPSING:\n" \
 "  LEFT or 0, RIGHT   collapse, expand\n" \
 "  1-9,*              expand 1-9,all levels\n" \
+"  RIGHT on (N smaller entries)  show the next page of them\n" \
+"SEARCHING:\n" \
+"  /     search for names (or paths, if it has a /) containing text\n" \
+"  ~     search for names (or paths) matching a regular expression\n" \
+"  ],[   next, previous match\n" \
+"  f     show only what matches a text or glob pattern, as you type it\n" \
+"  F     show only what matches an expression, e.g. dir && size > 1G\n" \
+"LARGEST ENTRIES:\n" \
+"  t,T   list largest files,directories anywhere in the tree\n" \
+"  z     list files and directories in a size range, e.g. 1G-2G\n" \
+"  e     total the files under the cursor by extension\n" \
+"  i     show how the sizes of the files under the cursor are spread\n" \
 "SORTING CHILDREN:\n" \
 "  s,S   sort,reverse sort by size\n" \
 "  n,N   sort,reverse sort by name\n" \
 "  u,U   unsort to original order\n" \
 "  d,D   sort,reverse sort by number of descendents\n" \
+"  v,V   sort,reverse sort by the chosen metric column (see --metric)\n" \
+"  g,G   sort,reverse sort by growth (see --history)\n" \
 "  =s, =S, =u, =U, -n, =N   sort recursively\n" \
 "MISCELLANY:\n" \
 "  #         show/hide number of descendents\n" \
+"  o         show/hide timings of the last redraw and operation\n" \
+"  M         show/hide metric columns\n" \
+"  m         choose the metric column v,V sort by\n" \
+"  w         show growth over the last 7 or 30 days\n" \
+"  r         update from newer du output in a file\n" \
 "  A         toggle ASCII line-drawing characters\n" \
 "  Ctrl-R    refresh display\n" \
 "  q,x,ESC   quit\n" \
@@ -0,0 +1,279 @@
+/*
+ * update.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "search.h"
+#include "sizeindex.h"
+#include "filter.h"
+#include "sketch.h"
+#include "update.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <glib.h>
+
+/* Newer du output for the same directories is applied to the tree in
+   place.  Nodes listed get their new sizes, new paths are linked in,
+   and anything that isn't listed and has nothing listed under it is
+   taken out.  Sizes (of nodes du didn't list) and descendent counts are
+   then recomputed only for the nodes that changed and their ancestors,
+   deepest first, since everything else still adds up.
+
+   The tree must be collapsed while this happens; see
+   tree_save_expanded(). */
+
+#define UPDATE_SEEN   1		/* still there */
+#define UPDATE_LISTED 2		/* has a size from the new output */
+#define UPDATE_DIRTY  4		/* on the dirty list */
+#define UPDATE_CHAIN  8		/* to be recomputed */
+#define UPDATE_LOST  16		/* has children that are gone */
+
+static unsigned char *flags = NULL; /* by id */
+static long flags_alloc = 0;
+static node_s **dirty = NULL;
+static long ndirty = 0;
+static long dirty_alloc = 0;
+
+/* Make room for flags for n nodes; new ones start out clear. */
+static void
+flags_reserve (long n)
+{
+	long alloc = flags_alloc ? flags_alloc : KIDSATATIME;
+
+	if (n <= flags_alloc) return;
+	while (alloc < n) alloc *= 2;
+	flags = realloc(flags, alloc);
+	if (!flags) {
+		perror("flags_reserve: realloc");
+		exit(1);
+	}
+	memset(flags + flags_alloc, 0, alloc - flags_alloc);
+	flags_alloc = alloc;
+}
+
+static unsigned char *
+node_flags (node_s *node)
+{
+	flags_reserve(node->id + 1);
+	return flags + node->id;
+}
+
+static void
+push (node_s ***list, long *n, long *alloc, node_s *node)
+{
+	if (*n >= *alloc) {
+		*alloc = *alloc ? *alloc * 2 : KIDSATATIME;
+		*list = realloc(*list, *alloc * sizeof(node_s *));
+		if (!*list) {
+			perror("update_tree: realloc");
+			exit(1);
+		}
+	}
+	(*list)[(*n)++] = node;
+}
+
+static void
+mark_dirty (node_s *node)
+{
+	unsigned char *f = node_flags(node);
+	if (*f & UPDATE_DIRTY) return;
+	*f |= UPDATE_DIRTY;
+	push(&dirty, &ndirty, &dirty_alloc, node);
+}
+
+/* Apply one line's worth of output. */
+static void
+update_path (node_s *root, char *path, TDU_SIZE_T size)
+{
+	node_s *node = root;
+	node_s *child;
+	char *name;
+
+	for (name = strtok(path, "/"); name; name = strtok(NULL, "/")) {
+		node_index_children(node);
+		child = g_hash_table_lookup(node->children_by_name, name);
+		if (!child) {
+			child = new_node(name);
+			add_child(node, child);
+			mark_dirty(child);
+			mark_dirty(node); /* its rollup, if any, is stale */
+		}
+		node = child;
+		*node_flags(node) |= UPDATE_SEEN;
+	}
+	*node_flags(node) |= UPDATE_LISTED;
+	if (node->size != size) {
+		node->size = size;
+		mark_dirty(node);
+	}
+}
+
+/* Take the children that are gone out of a node's list, keeping the
+   order of the rest, and free them. */
+static long
+remove_lost (node_s *node)
+{
+	long i, n, removed = 0;
+
+	for (i = n = 0; i < node->nchildren; ++i) {
+		node_s *child = node->children[i];
+		if (*node_flags(child) & UPDATE_SEEN) {
+			node->children[n++] = child;
+		}
+		else {
+			removed += 1 + child->descendents;
+			free_tree(child);
+		}
+	}
+	node->nchildren = n;
+	return removed;
+}
+
+typedef struct chain_entry {
+	node_s *node;
+	long depth;
+} chain_entry_s;
+
+static int
+chain_cmp (const void *aa, const void *bb)
+{
+	const chain_entry_s *a = aa;
+	const chain_entry_s *b = bb;
+	return (a->depth < b->depth) - (a->depth > b->depth);
+}
+
+/* Recompute a node from its children. */
+static void
+recompute (node_s *node)
+{
+	TDU_SIZE_T size = 0;
+	long descendents = 0;
+	long i;
+
+	for (i = 0; i < node->nchildren; ++i) {
+		size += node->children[i]->size;
+		descendents += 1 + node->children[i]->descendents;
+		node->children[i]->is_last_child = (i == node->nchildren - 1);
+	}
+	if (!(*node_flags(node) & UPDATE_LISTED) && node->nchildren)
+		node->size = size;
+	node->descendents = descendents;
+	sketch_merge(node);
+
+	/* whether or not to roll up is decided again on expanding */
+	node_rollup_free(node);
+	node->nshown = 0;
+}
+
+/* Apply du output read from pathname ("-" or NULL for stdin) to the
+   tree under root.  Returns the number of nodes added, changed or
+   removed, or -1 if it can't be read. */
+long
+update_tree (node_s *root, const char *pathname)
+{
+	FILE *in;
+	char line[PATH_MAX+256];
+	char path[PATH_MAX];
+	TDU_SIZE_T size;
+	node_s **chain = NULL;
+	chain_entry_s *order;
+	long nchain = 0, chain_alloc = 0;
+	long changed, i;
+	node_s *p;
+
+	if (!pathname || !strcmp(pathname, "-")) {
+		in = stdin;
+	}
+	else if (!(in = fopen(pathname, "r"))) {
+		return -1;
+	}
+
+	/* nothing may be looking at node_table while it changes */
+	search_index_invalidate();
+	size_index_invalidate();
+	filter_reset();
+
+	flags_reserve(node_table_size);
+	memset(flags, 0, flags_alloc);
+	ndirty = 0;
+	*node_flags(root) |= UPDATE_SEEN;
+
+	while (fgets(line, sizeof(line), in)) {
+		if (parse_du_line(line, &size, path))
+			update_path(root, path, size);
+	}
+	if (in != stdin) fclose(in);
+	cleanup_tree(root);
+
+	/* find what's gone: nodes not seen whose parents were.  Nodes
+	   that are there but weren't listed have their sizes added up
+	   again, in case they were listed last time.  That includes the
+	   nodes a folded chain came apart into (see node_unfold()); the
+	   ones added since are all marked seen. */
+	changed = ndirty;
+	for (i = 0; i < node_table_size; ++i) {
+		node_s *node = node_table[i];
+		if (!node || !node->parent) continue;
+		if ((*node_flags(node) & (UPDATE_SEEN | UPDATE_LISTED))
+		    == UPDATE_SEEN) {
+			mark_dirty(node);
+			continue;
+		}
+		if ((*node_flags(node) & UPDATE_SEEN)
+		    || !(*node_flags(node->parent) & UPDATE_SEEN))
+			continue;
+		*node_flags(node->parent) |= UPDATE_LOST;
+		mark_dirty(node->parent);
+	}
+	for (i = 0; i < ndirty; ++i)
+		if (*node_flags(dirty[i]) & UPDATE_LOST)
+			changed += remove_lost(dirty[i]);
+
+	/* everything from the dirty nodes up is recomputed, deepest
+	   first */
+	for (i = 0; i < ndirty; ++i) {
+		for (p = dirty[i];
+		     p && !(*node_flags(p) & UPDATE_CHAIN); p = p->parent) {
+			*node_flags(p) |= UPDATE_CHAIN;
+			push(&chain, &nchain, &chain_alloc, p);
+		}
+	}
+	order = malloc((nchain + 1) * sizeof(chain_entry_s));
+	if (!order) {
+		perror("update_tree: malloc");
+		exit(1);
+	}
+	for (i = 0; i < nchain; ++i) {
+		order[i].node = chain[i];
+		order[i].depth = 0;
+		for (p = chain[i]->parent; p; p = p->parent)
+			++order[i].depth;
+	}
+	qsort(order, nchain, sizeof(chain_entry_s), chain_cmp);
+	for (i = 0; i < nchain; ++i)
+		recompute(order[i].node);
+	free(order);
+	free(chain);
+	return changed;
+}
@@ -0,0 +1,244 @@
+/*
+ * walk.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "spill.h"
+#include "sketch.h"
+#include "walk.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <glib.h>
+
+/* Instead of reading du's output, tdu can go through a directory tree
+   itself, as du -a would: each entry's size is the disk space lstat()
+   says it takes, in units of the block size, a directory's is its own
+   plus everything in it, and a file with several hard links is counted
+   the first time it's seen.  Symbolic links aren't followed.
+
+   Sizes are rounded to whole blocks entry by entry, rather than only
+   once for each directory's total as du does, so that a change to one
+   entry changes the directories above it by the same amount; see
+   watch.c. */
+
+void (*walk_dir_hook) (node_s *dir, const char *path) = NULL;
+bool (*walk_defer_hook) (node_s *dir, const struct stat *st) = NULL;
+bool walk_quiet = 0;		/* say nothing about unreadable entries */
+
+static GHashTable *inodes = NULL; /* hard links counted already */
+static long entries = 0;
+static int show_progress = 0;
+static char walk_root[PATH_MAX];	/* the top, as realpath() has it */
+static char walk_top[PATH_MAX];		/* and as node_path() has it */
+
+TDU_SIZE_T
+walk_blocks (const struct stat *st)
+{
+	return ((TDU_SIZE_T)st->st_blocks * 512 + tdu_block_size - 1)
+		/ tdu_block_size;
+}
+
+static void
+walk_warn (const char *path)
+{
+	if (!walk_quiet)
+		fprintf(stderr, "tdu: %s: %s\n", path, strerror(errno));
+}
+
+static int
+walk_name_cmp (const void *a, const void *b)
+{
+	return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+/* Read a directory's entries into node, adding their sizes and
+   numbers of descendents to its.  path, len characters long, is its
+   pathname, in a buffer of PATH_MAX. */
+void
+walk_dir (node_s *node, char *path, int len)
+{
+	DIR *dir;
+	struct dirent *de;
+	struct stat st;
+	char **names = NULL;
+	long n = 0, alloc = 0, i;
+	int sublen;
+
+	if (walk_dir_hook) walk_dir_hook(node, path);
+	if (!(dir = opendir(path))) {
+		walk_warn(path);
+		return;
+	}
+	/* the names are all read first so that no more than one directory
+	   is open at a time, however deep the tree */
+	while ((de = readdir(dir))) {
+		if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+			continue;
+		if (n == alloc) {
+			alloc = alloc ? alloc * 2 : 64;
+			if (!(names = realloc(names, alloc * sizeof(char *)))) {
+				perror("walk_dir: realloc");
+				exit(1);
+			}
+		}
+		if (!(names[n++] = strdup(de->d_name))) {
+			perror("walk_dir: strdup");
+			exit(1);
+		}
+	}
+	closedir(dir);
+	qsort(names, n, sizeof(char *), walk_name_cmp);
+
+	for (i = 0; i < n; ++i) {
+		node_s *child;
+
+		sublen = len + (path[len - 1] != '/') + strlen(names[i]);
+		if (sublen >= PATH_MAX) {
+			errno = ENAMETOOLONG;
+			walk_warn(names[i]);
+		}
+		else {
+			if (path[len - 1] != '/') path[len] = '/';
+			strcpy(path + sublen - strlen(names[i]), names[i]);
+			if (lstat(path, &st)) {
+				walk_warn(path);
+			}
+			else {
+				child = walk_add(node, names[i], path, sublen,
+						 &st);
+				node->size += child->size;
+				node->descendents += 1 + child->descendents;
+			}
+			path[len] = '\0';
+		}
+		free(names[i]);
+	}
+	free(names);
+	sketch_merge(node);
+
+	if (node->children_by_name) {
+		g_hash_table_destroy(node->children_by_name);
+		node->children_by_name = NULL;
+	}
+}
+
+/* Add the entry at path, len characters long in a buffer of PATH_MAX,
+   whose lstat() is st, to parent under name, along with everything in
+   it.  Returns the new node. */
+node_s *
+walk_add (node_s *parent, const char *name, char *path, int len,
+	  const struct stat *st)
+{
+	node_s *node = new_node(name);
+	gpointer key = (gpointer)(long)(st->st_ino
+					^ ((unsigned long) st->st_dev << 40));
+
+	add_child(parent, node);
+	node->size = walk_blocks(st);
+	node->descendents = 0;
+	if (!S_ISDIR(st->st_mode) && st->st_nlink > 1) {
+		if (!inodes)
+			inodes = g_hash_table_new(g_direct_hash,
+						  g_direct_equal);
+		if (g_hash_table_lookup(inodes, key))
+			node->size = 0;
+		else
+			g_hash_table_insert(inodes, key, key);
+	}
+	if (S_ISDIR(st->st_mode)
+	    && !(walk_defer_hook && walk_defer_hook(node, st))) {
+		walk_dir(node, path, len);
+		if (tdu_memory_limit && node_memory > tdu_memory_limit)
+			spill_node(node);
+	}
+	if (show_progress && !(++entries % 100))
+		fprintf(stderr, "  %ld entries\r", entries);
+	return node;
+}
+
+/* Write the pathname of a node read by walk_tree() into buf, as
+   node_path() would but starting from the absolute pathname of the
+   top, so that it names the same file whatever the top was called.
+   Returns its length. */
+int
+walk_path (node_s *node, char *buf, int size)
+{
+	char path[PATH_MAX];
+	int len = node_path(node, path, sizeof(path));
+	int top = strlen(walk_top);
+
+	if (!walk_root[0] || len >= sizeof(path)
+	    || strncmp(path, walk_top, top)
+	    || (path[top] && path[top] != '/'))
+		return node_path(node, buf, size);
+	return snprintf(buf, size, "%s%s", walk_root, path + top);
+}
+
+/* Go through the tree at dir, as du -a would, and return a tree like
+   parse_file()'s, or NULL, having said why, if dir can't be read. */
+node_s *
+walk_tree (const char *dir)
+{
+	node_s *root, *top;
+	struct stat st;
+	char path[PATH_MAX];
+	int len = strlen(dir);
+
+	if (len >= PATH_MAX) {
+		errno = ENAMETOOLONG;
+		walk_warn(dir);
+		return NULL;
+	}
+	if (lstat(dir, &st)) {
+		walk_warn(dir);
+		return NULL;
+	}
+	strcpy(path, dir);
+	root = new_node(NULL);
+	root->name = "[root]";	/* no strdup necessary or wanted */
+
+	show_progress = !walk_quiet && isatty(fileno(stderr));
+	entries = 0;
+	top = add_node(root, dir, walk_blocks(&st));
+	top->descendents = 0;
+	if (!realpath(dir, walk_root)
+	    || node_path(top, walk_top, sizeof(walk_top)) >= sizeof(walk_top))
+		walk_root[0] = walk_top[0] = '\0';
+
+	/* the top is read even if directories are being left for later */
+	if (S_ISDIR(st.st_mode))
+		walk_dir(top, path, len);
+	if (show_progress)
+		fprintf(stderr, "  %ld entries total\n", entries + 1);
+	show_progress = 0;
+
+	fix_tree_sizes(root);
+	fix_tree_descendents(root);
+	cleanup_tree(root);
+	return root;
+}
@@ -0,0 +1,45 @@
+/*
+ * walk.h
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#ifndef WALK_H
+#define WALK_H
+/*****************************************************************************/
+
+#include "tdu.h"
+#include "node.h"
+#include <sys/stat.h>
+
+/* called with each directory as it's about to be read, if set */
+extern void (*walk_dir_hook) (node_s *dir, const char *path);
+/* called with each directory but the top as it's found; if it returns
+   1, the directory is left unread, for walk_dir() later */
+extern bool (*walk_defer_hook) (node_s *dir, const struct stat *st);
+extern bool walk_quiet;
+
+TDU_SIZE_T walk_blocks (const struct stat *st);
+void walk_dir (node_s *node, char *path, int len);
+node_s *walk_add (node_s *parent, const char *name, char *path, int len,
+		  const struct stat *st);
+int walk_path (node_s *node, char *buf, int size);
+node_s *walk_tree (const char *dir);
+
+/*****************************************************************************/
+#endif /* WALK_H */
@@ -0,0 +1,231 @@
+/*
+ * watch.c
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#include "tdu.h"
+#include "node.h"
+#include "walk.h"
+#include "search.h"
+#include "sizeindex.h"
+#include "filter.h"
+#include "bfs.h"
+#include "sketch.h"
+#include "watch.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <glib.h>
+
+/* With --watch, every directory walk_tree() goes through is watched
+   with inotify, and whatever changes in them is applied to the tree as
+   it happens: a file that grows or shrinks changes the sizes of the
+   directories above it by as much, an entry that appears is gone
+   through and linked in, and one that goes away is taken out along
+   with everything under it.
+
+   Directories that have been written out by --memory-limit aren't in
+   the tree to be changed, and changes in them are missed. */
+
+#define WATCH_EVENTS (IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB \
+		      | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO)
+
+bool watch_overflowed = 0;	/* events were lost */
+
+static int watch_fd = -1;
+static GHashTable *watches = NULL; /* directory ids + 1, by watch */
+static bool watch_exhausted = 0;
+
+static void (*reshape_hook) (void);
+static bool reshaped;
+
+static void
+watch_dir (node_s *dir, const char *path)
+{
+	int wd;
+
+	if (watch_exhausted) return;
+	wd = inotify_add_watch(watch_fd, path, WATCH_EVENTS | IN_ONLYDIR
+			       | IN_DONT_FOLLOW | IN_EXCL_UNLINK);
+	if (wd < 0) {
+		if (errno == ENOSPC) {
+			watch_exhausted = 1;
+			if (!walk_quiet)
+				fprintf(stderr, "tdu: out of inotify watches "
+					"(see fs.inotify.max_user_watches); "
+					"not watching the rest\n");
+		}
+		return;
+	}
+	g_hash_table_insert(watches, (gpointer)(long)wd,
+			    (gpointer)(dir->id + 1));
+}
+
+/* Watch the directories walk_tree() goes through from now on.  Returns
+   0, or -1 with errno set. */
+int
+watch_start ()
+{
+	if ((watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0)
+		return -1;
+	watches = g_hash_table_new(g_direct_hash, g_direct_equal);
+	walk_dir_hook = watch_dir;
+	return 0;
+}
+
+/* for poll(), or -1 if nothing is being watched */
+int
+watch_fileno ()
+{
+	return watch_fd;
+}
+
+/* Let the caller get ready for entries to come and go, the first time
+   one does. */
+static void
+watch_reshape ()
+{
+	if (reshaped) return;
+	reshaped = 1;
+	if (reshape_hook) reshape_hook();
+	search_index_invalidate();
+	filter_reset();
+}
+
+/* Change the sizes and descendent counts of a node and everything
+   above it.  Rollups along the way are made again on expanding, as in
+   update.c, since what they add up is changing. */
+static void
+watch_adjust (node_s *node, long long size, long descendents)
+{
+	for (; node; node = node->parent) {
+		if (node->rollup) {
+			watch_reshape();
+			node_rollup_free(node);
+			node->nshown = 0;
+		}
+		node->size += size;
+		node->descendents += descendents;
+	}
+}
+
+static void
+watch_remove (node_s *dir, node_s *child)
+{
+	watch_reshape();
+	watch_adjust(dir, -(long long)child->size, -(1 + child->descendents));
+	remove_child(dir, child);
+	bfs_forget(child);
+	sketch_forget(child);
+	free_tree(child);
+	sketch_merge_up(dir);
+}
+
+/* Bring the entry called name in dir up to date.  Returns 1 if it
+   changed. */
+static int
+watch_entry (node_s *dir, const char *name, uint32_t mask)
+{
+	char path[PATH_MAX];
+	struct stat st;
+	node_s *child;
+	long long delta;
+	int len;
+
+	node_index_children(dir);
+	child = g_hash_table_lookup(dir->children_by_name, name);
+	len = walk_path(dir, path, sizeof(path));
+	if (len + 1 + strlen(name) >= sizeof(path)) return 0;
+	if (!len || path[len - 1] != '/') path[len++] = '/';
+	strcpy(path + len, name);
+	len += strlen(name);
+
+	if (lstat(path, &st)) {
+		if (!child) return 0;
+		watch_remove(dir, child);
+		return 1;
+	}
+	if (child && !(mask & (IN_CREATE | IN_MOVED_TO))) {
+		/* a directory's own size hardly changes, and what's in it
+		   is watched itself */
+		if (S_ISDIR(st.st_mode) || child->nchildren
+		    || (st.st_nlink > 1 && !child->size))
+			return 0;
+		delta = (long long)walk_blocks(&st) - child->size;
+		if (!delta) return 0;
+		watch_adjust(child, delta, 0);
+		sketch_merge_up(dir);
+		return 1;
+	}
+	if (child) watch_remove(dir, child);
+	watch_reshape();
+	/* the new entry goes at the end, which may be rolled up */
+	node_rollup_free(dir);
+	dir->nshown = 0;
+	child = walk_add(dir, name, path, len, &st);
+	watch_adjust(dir, child->size, 1 + child->descendents);
+	sketch_merge_up(dir);
+	return 1;
+}
+
+/* Apply whatever has changed since the last call.  reshape is called
+   before the first entry comes or goes, while nothing has changed yet.
+   Returns the number of entries changed. */
+long
+watch_read (void (*reshape) (void))
+{
+	char buf[64 * 1024]
+		__attribute__ ((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	long changed = 0, len, id;
+	char *p;
+	node_s *dir;
+
+	reshape_hook = reshape;
+	reshaped = 0;
+	walk_quiet = 1;
+	while ((len = read(watch_fd, buf, sizeof(buf))) > 0) {
+		for (p = buf; p < buf + len;
+		     p += sizeof(struct inotify_event) + ev->len) {
+			ev = (const struct inotify_event *) p;
+			if (ev->mask & IN_Q_OVERFLOW) {
+				watch_overflowed = 1;
+				continue;
+			}
+			if (ev->mask & IN_IGNORED) {
+				g_hash_table_remove(watches,
+						    (gpointer)(long)ev->wd);
+				continue;
+			}
+			if (!ev->len) continue;
+			id = (long)g_hash_table_lookup(watches,
+						       (gpointer)(long)ev->wd) - 1;
+			if (id < 0 || id >= node_table_size
+			    || !(dir = node_table[id]))
+				continue;
+			changed += watch_entry(dir, ev->name, ev->mask);
+		}
+	}
+	if (changed) size_index_invalidate();
+	return changed;
+}
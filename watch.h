@@ -0,0 +1,36 @@
+/*
+ * watch.h
+ * This file is part of tdu, a text-mode disk usage visualization utility.
+ *
+ * Copyright (C) 2004-2012 Darren Stuart Embry.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *                                                                             
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *                                                                             
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307$
+ */
+
+#ifndef WATCH_H
+#define WATCH_H
+/*****************************************************************************/
+
+#include "tdu.h"
+#include "node.h"
+
+extern bool watch_overflowed;
+
+int watch_start (void);
+int watch_fileno (void);
+long watch_read (void (*reshape) (void));
+
+/*****************************************************************************/
+#endif /* WATCH_H */